@@ -0,0 +1,449 @@
+//microbenchmark for the ghost decision kernel: cost per decision of navigateGhosts over parallel arrays,
+//of Ghost::navigate called on every ghost object and of the original Ghost::navigate, printed as JSON
+//both variants are checked against the original one
+//with -threads the batched kernel is also timed on a job system and checked against the serial results
+//afterwards the ghosts walk the way they decided through a SpatialHash, which answers player contact and
+//nearest ghost and ghosts in range queries, those are checked against scanning every ghost
+//last they chase a few players through a maze on shared flow fields, the paths some of them walk by Ghost::chase
+//have to be as long as a breadth first search from each of them finds
+//usage: bench ghosts [-ghosts n] [-rounds n] [-seed n] [-threads n] [-queries n]
+
+#include "Entity.h"
+#include "GhostKernel.h"
+#include "JobSystem.h"
+#include "Tilemap.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <string>
+#include <cstdlib>
+
+using namespace std;
+using namespace std::chrono;
+
+//Ghost::navigate, chase and flee as they were before the decision tables, for checking the kernel against
+//only rand() is swapped for the ghost's own random state, which the kernel draws from the same way
+static Direction baselineChase(int deltaX, int deltaY, Direction directions)
+{
+	vector<Direction> choices;
+	choices.push_back(RIGHT);
+	choices.push_back(DOWN);
+	choices.push_back(LEFT);
+	choices.push_back(UP);
+
+	//arrange directions from best to worst
+	if (deltaX < 0)
+		swap(choices[0], choices[2]);
+	if (deltaY < 0)
+		swap(choices[1], choices[3]);
+	if (abs(deltaX) < abs(deltaY))
+	{
+		swap(choices[0], choices[1]);
+		swap(choices[2], choices[3]);
+	}
+
+	//pick best one available
+	for (auto &i : choices)
+	{
+		if (i & directions) return i;
+	}
+	return NONE;
+}
+
+static Direction baselineFlee(Direction directions, Uint32 &rng)
+{
+	vector<Direction> choices;
+	if (directions & UP)	choices.push_back(UP);
+	if (directions & DOWN)	choices.push_back(DOWN);
+	if (directions & LEFT)	choices.push_back(LEFT);
+	if (directions & RIGHT)	choices.push_back(RIGHT);
+
+	if (choices.size() == 1) return choices.front();
+	else return choices[nextRandom(rng) % choices.size()];
+}
+
+static Direction baselineNavigate(Direction direction, Direction directions, Chasemode mode, int deltaX, int deltaY, Uint32 &rng)
+{
+	Direction opposite = NONE;
+	if (direction)
+	{
+		switch (direction)
+		{
+		case UP:	opposite = DOWN;	break;
+		case DOWN:	opposite = UP;		break;
+		case LEFT:	opposite = RIGHT;	break;
+		case RIGHT:	opposite = LEFT;	break;
+		default: break;
+		}
+
+		directions = (Direction)(directions & ~opposite);
+
+		if (directions == NONE) directions = opposite;
+	}
+
+	switch (directions)
+	{
+	case UP:	return UP;
+	case DOWN:	return DOWN;
+	case LEFT:	return LEFT;
+	case RIGHT:	return RIGHT;
+	default: break;
+	}
+
+	switch (mode)
+	{
+	case CHASE:
+	case SCATTER:	return baselineChase(deltaX, deltaY, directions);
+	case AFRAID:	return baselineFlee(directions, rng);
+	default:		return direction;
+	}
+}
+
+//steps on the shortest path between two free tiles, -1 if there is none, searched from the start
+static int pathLength(const Tilemap &map, int from, int to, vector<int> &queue, vector<int> &dist)
+{
+	int width = map.horiTiles;
+	dist.assign(map.tiles.size(), -1);
+	queue.clear();
+	queue.push_back(from);
+	dist[from] = 0;
+	for (size_t head = 0; head < queue.size() && dist[to] < 0; head++)
+	{
+		int in = queue[head];
+		int x = in % width;
+		int neighbours[4] = { in - width, in + width, in - 1, in + 1 };
+		bool inside[4] = { in >= width, in + width < (int)map.tiles.size(), x > 0, x < width - 1 };
+		for (int i = 0; i < 4; i++)
+		{
+			int n = neighbours[i];
+			if (!inside[i] || dist[n] >= 0 || map.isSolid(map.tiles[n])) continue;
+			dist[n] = dist[in] + 1;
+			queue.push_back(n);
+		}
+	}
+	return dist[to];
+}
+
+int runGhostBench(int argc, char *argv[])
+{
+	int count = 100000;
+	int rounds = 200;
+	unsigned seed = 1;
+	int threads = 0;
+	int queries = 1000;		//players looked up per round
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		string arg = argv[i];
+		if (arg == "-ghosts") count = atoi(argv[i + 1]);
+		else if (arg == "-rounds") rounds = atoi(argv[i + 1]);
+		else if (arg == "-seed") seed = (unsigned)atoi(argv[i + 1]);
+		else if (arg == "-threads") threads = atoi(argv[i + 1]);
+		else if (arg == "-queries") queries = atoi(argv[i + 1]);
+		else
+		{
+			cerr << "unknown option " << arg << endl;
+			return 1;
+		}
+	}
+	if (count < 1 || rounds < 1 || queries < 1)
+	{
+		cerr << "ghosts, rounds and queries must be positive" << endl;
+		return 1;
+	}
+
+	//random but reproducible situations, the same for both variants
+	mt19937 rng(seed);
+	Uint8 modes[3] = { CHASE, SCATTER, AFRAID };
+	Uint8 singles[4] = { UP, DOWN, LEFT, RIGHT };
+	vector<Uint8> direction(count), available(count), mode(count);
+	vector<int> x(count), y(count), targetX(count), targetY(count), homeX(count), homeY(count);
+	vector<Uint32> states(count);
+	for (int i = 0; i < count; i++)
+	{
+		direction[i] = singles[rng() % 4];
+		available[i] = Uint8(1 + rng() % 15);
+		mode[i] = modes[rng() % 3];
+		x[i] = rng() % 4096;
+		y[i] = rng() % 4096;
+		targetX[i] = rng() % 4096;
+		targetY[i] = rng() % 4096;
+		homeX[i] = rng() % 4096;
+		homeY[i] = rng() % 4096;
+		states[i] = i + 1;
+	}
+
+	vector<Ghost> ghosts(count);
+	for (int i = 0; i < count; i++)
+	{
+		ghosts[i].direction = (Direction)direction[i];
+		ghosts[i].mode = (Chasemode)mode[i];
+		ghosts[i].x = x[i];
+		ghosts[i].y = y[i];
+		ghosts[i].targetX = targetX[i];
+		ghosts[i].targetY = targetY[i];
+		ghosts[i].homeX = homeX[i];
+		ghosts[i].homeY = homeY[i];
+		ghosts[i].seed(i + 1);
+	}
+
+	//untouched copies for the parallel and the original run
+	vector<Uint8> parallelDirection = direction;
+	vector<Uint32> parallelStates = states;
+	vector<Uint8> baselineDirection = direction;
+	vector<Uint32> baselineStates = states;
+
+	GhostLanes lanes = { direction.data(), available.data(), mode.data(), nullptr, x.data(), y.data(),
+		targetX.data(), targetY.data(), homeX.data(), homeY.data(), states.data(), (unsigned)count };
+
+	steady_clock::time_point start = steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		navigateGhosts(lanes);
+	}
+	double batched = duration<double, nano>(steady_clock::now() - start).count() / (double(count)*rounds);
+
+	start = steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			ghosts[i].navigate((Direction)available[i]);
+		}
+	}
+	double single = duration<double, nano>(steady_clock::now() - start).count() / (double(count)*rounds);
+
+	start = steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			bool scatter = mode[i] == SCATTER;
+			int deltaX = (scatter ? homeX[i] : targetX[i]) - x[i];
+			int deltaY = (scatter ? homeY[i] : targetY[i]) - y[i];
+			baselineDirection[i] = baselineNavigate((Direction)baselineDirection[i], (Direction)available[i], (Chasemode)mode[i], deltaX, deltaY, baselineStates[i]);
+		}
+	}
+	double baseline = duration<double, nano>(steady_clock::now() - start).count() / (double(count)*rounds);
+
+	double parallel = 0.0;
+	if (threads > 0)
+	{
+		JobSystem jobs(threads);
+		GhostLanes parallelLanes = lanes;
+		parallelLanes.direction = parallelDirection.data();
+		parallelLanes.rng = parallelStates.data();
+
+		start = steady_clock::now();
+		for (int r = 0; r < rounds; r++)
+		{
+			navigateGhosts(parallelLanes, &jobs);
+		}
+		parallel = duration<double, nano>(steady_clock::now() - start).count() / (double(count)*rounds);
+	}
+
+	//all variants decide like the original code, checking that also keeps the work from being optimized away
+	int mismatches = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (direction[i] != baselineDirection[i]) mismatches++;
+		if (ghosts[i].direction != baselineDirection[i]) mismatches++;
+		if (threads > 0 && parallelDirection[i] != baselineDirection[i]) mismatches++;
+	}
+
+	//the grid only needs the tile size of the sheet
+	Spritesheet sheet;
+	sheet.tileRes = 32;
+	SpatialHash grid(sheet.tileRes);
+	for (auto &i : ghosts)
+	{
+		i.sprites = &sheet;
+		i.speed = 2;
+		grid.insert(&i);
+	}
+
+	vector<SDL_Point> players(queries);
+	for (auto &i : players)
+	{
+		i.x = rng() % 4096;
+		i.y = rng() % 4096;
+	}
+
+	double moveTime = 0.0;
+	double contactTime = 0.0;
+	double nearestTime = 0.0;
+	double radiusTime = 0.0;
+	unsigned contacts = 0;
+	int radius = 3 * sheet.tileRes;	//ghosts close enough for the player to hear
+	vector<Entity*> found;
+	for (int r = 0; r < rounds; r++)
+	{
+		//some walk off the top and left edges, into negative tiles
+		start = steady_clock::now();
+		for (auto &i : ghosts)
+		{
+			i.move();
+			i.updateTile();
+		}
+		moveTime += duration<double, nano>(steady_clock::now() - start).count();
+
+		start = steady_clock::now();
+		for (auto &i : players)
+		{
+			SDL_Rect box = { i.x, i.y, sheet.tileRes, sheet.tileRes };
+			found.clear();
+			grid.queryRect(box, found);
+			contacts += found.size();
+		}
+		contactTime += duration<double, nano>(steady_clock::now() - start).count();
+
+		start = steady_clock::now();
+		for (auto &i : players)
+		{
+			found.clear();
+			grid.queryNearest(i.x, i.y, 1, found);
+		}
+		nearestTime += duration<double, nano>(steady_clock::now() - start).count();
+
+		start = steady_clock::now();
+		for (auto &i : players)
+		{
+			found.clear();
+			grid.queryRadius(i.x, i.y, radius, found);
+		}
+		radiusTime += duration<double, nano>(steady_clock::now() - start).count();
+	}
+
+	//the scan is far slower, so only some of the players are checked
+	int checked = min(queries, 100);
+	vector<Entity*> scanned, inRange;
+	start = steady_clock::now();
+	for (int p = 0; p < checked; p++)
+	{
+		const SDL_Point &player = players[p];
+		scanned.clear();
+		inRange.clear();
+		Sint64 nearest = INT64_MAX;
+		for (auto &i : ghosts)
+		{
+			if (i.x < player.x + sheet.tileRes && i.x + sheet.tileRes > player.x && i.y < player.y + sheet.tileRes && i.y + sheet.tileRes > player.y) scanned.push_back(&i);
+			Sint64 dx = i.x - player.x;
+			Sint64 dy = i.y - player.y;
+			nearest = min(nearest, dx*dx + dy*dy);
+			if (dx*dx + dy*dy <= Sint64(radius)*radius) inRange.push_back(&i);
+		}
+
+		SDL_Rect box = { player.x, player.y, sheet.tileRes, sheet.tileRes };
+		found.clear();
+		grid.queryRect(box, found);
+		sort(found.begin(), found.end());
+		sort(scanned.begin(), scanned.end());
+		if (found != scanned) mismatches++;
+
+		found.clear();
+		grid.queryNearest(player.x, player.y, 1, found);
+		Sint64 dx = found[0]->x - player.x;
+		Sint64 dy = found[0]->y - player.y;
+		if (dx*dx + dy*dy != nearest) mismatches++;
+
+		found.clear();
+		grid.queryRadius(player.x, player.y, radius, found);
+		sort(found.begin(), found.end());
+		sort(inRange.begin(), inRange.end());
+		if (found != inRange) mismatches++;
+	}
+	double scanTime = duration<double, nano>(steady_clock::now() - start).count() / checked;
+	grid.clear();
+
+	//a maze over the same area, about a third of it walls so some pockets are closed off
+	Tilemap maze;
+	maze.create((char)sheet.tileRes, 4096 / sheet.tileRes, 4096 / sheet.tileRes, "");
+	for (auto &i : maze.tiles) i = rng() % 3 == 0 ? 1 : 0;
+	maze.buildSolidIndex();
+
+	//every ghost chases one of a few players, so they share fewer fields than the cache holds
+	const int chased = 8;
+	int targets[chased];
+	for (auto &i : targets)
+	{
+		do i = rng() % maze.tiles.size();
+		while (maze.isSolid(maze.tiles[i]));
+	}
+
+	FlowFields fields(&maze);
+	start = steady_clock::now();
+	for (int i : targets) fields.get(i % maze.horiTiles, i / maze.horiTiles);
+	double fieldTime = duration<double, micro>(steady_clock::now() - start).count() / chased;
+
+	Uint8 ways = 0;
+	start = steady_clock::now();
+	for (int r = 0; r < rounds; r++)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			int target = targets[i % chased];
+			ways |= fields.next(x[i] / sheet.tileRes, y[i] / sheet.tileRes, target % maze.horiTiles, target / maze.horiTiles);
+		}
+	}
+	double nextTime = duration<double, nano>(steady_clock::now() - start).count() / (double(count)*rounds);
+
+	//walk ghosts on free tiles the way the fields send them, it has to take exactly as many steps as the search finds
+	Ghost walker;
+	walker.sprites = &sheet;
+	walker.flow = &fields;
+	int walked = 0;
+	int unreachable = 0;
+	vector<int> queue, dist;
+	for (int i = 0; i < count && walked < checked * 10; i++)
+	{
+		int from = (y[i] / sheet.tileRes)*maze.horiTiles + x[i] / sheet.tileRes;
+		int target = targets[i % chased];
+		int tx = target % maze.horiTiles;
+		int ty = target / maze.horiTiles;
+		if (maze.isSolid(maze.tiles[from])) continue;
+		walked++;
+
+		int length = pathLength(maze, from, target, queue, dist);
+		if (length < 0)
+		{
+			unreachable++;
+			if (fields.next(from % maze.horiTiles, from / maze.horiTiles, tx, ty) != NONE) mismatches++;
+			continue;
+		}
+
+		int at = from;
+		int steps = 0;
+		for (; at != target && steps <= length; steps++)
+		{
+			walker.x = (at % maze.horiTiles)*sheet.tileRes;
+			walker.y = (at / maze.horiTiles)*sheet.tileRes;
+			Direction way = walker.chase(tx*sheet.tileRes, ty*sheet.tileRes, (Direction)(UP | DOWN | LEFT | RIGHT));
+			int ax = at % maze.horiTiles + (way == RIGHT) - (way == LEFT);
+			int ay = at / maze.horiTiles + (way == DOWN) - (way == UP);
+			if (ax < 0 || ay < 0 || ax >= maze.horiTiles || ay >= maze.vertiTiles) break;
+			at = ay*maze.horiTiles + ax;
+			if (maze.isSolid(maze.tiles[at])) break;
+		}
+		if (at != target || steps != length) mismatches++;
+	}
+
+	cout << "{" << endl;
+	cout << "\t\"ghosts\": " << count << "," << endl;
+	cout << "\t\"rounds\": " << rounds << "," << endl;
+	cout << "\t\"unit\": \"ns per decision\"," << endl;
+	cout << "\t\"navigateGhosts\": " << batched << "," << endl;
+	cout << "\t\"Ghost::navigate\": " << single << "," << endl;
+	cout << "\t\"original Ghost::navigate\": " << baseline << "," << endl;
+	if (threads > 0) cout << "\t\"navigateGhosts parallel\": " << parallel << "," << endl;
+	if (threads > 0) cout << "\t\"threads\": " << threads << "," << endl;
+	cout << "\t\"grid\": { \"unit\": \"ns per ghost or query\", \"queries\": " << queries << ", \"contacts\": " << contacts
+		<< ", \"move\": " << moveTime / (double(count)*rounds) << ", \"contact\": " << contactTime / (double(queries)*rounds)
+		<< ", \"nearest\": " << nearestTime / (double(queries)*rounds) << ", \"radius\": " << radiusTime / (double(queries)*rounds) << ", \"scan\": " << scanTime << " }," << endl;
+	cout << "\t\"flow\": { \"fields\": " << chased << ", \"field_us\": " << fieldTime << ", \"next_ns\": " << nextTime
+		<< ", \"walked\": " << walked << ", \"unreachable\": " << unreachable << ", \"directions\": " << (int)ways << " }," << endl;
+	cout << "\t\"mismatches\": " << mismatches << endl;
+	cout << "}" << endl;
+
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+//checks of the map run by the frame benchmark after its last frame: the incremental paths against doing the same work from scratch,
+//and the saved file against what it was saved from. every one returns how many things differ
+
+#include "Tilemap.h"
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <climits>
+
+using namespace std;
+
+//distance tables and solid mask kept up by changeTile against a fresh buildSolidIndex, returns differing cells
+unsigned checkSolidIndex(Tilemap &map)
+{
+	vector<Uint16> up = map.distUp;
+	vector<Uint16> down = map.distDown;
+	vector<Uint16> left = map.distLeft;
+	vector<Uint16> right = map.distRight;
+	vector<Uint64> mask = map.solidMask;
+	map.buildSolidIndex();
+
+	unsigned bad = 0;
+	for (size_t i = 0; i < map.tiles.size(); i++)
+	{
+		if (up[i] != map.distUp[i] || down[i] != map.distDown[i] || left[i] != map.distLeft[i] || right[i] != map.distRight[i]) bad++;
+	}
+	for (size_t i = 0; i < mask.size(); i++)
+	{
+		if (mask[i] != map.solidMask[i]) bad++;
+	}
+	return bad;
+}
+
+static vector<Uint32> readTexture(SDL_Texture *texture, Window *window)
+{
+	int w, h;
+	SDL_QueryTexture(texture, NULL, NULL, &w, &h);
+	vector<Uint32> pixels(w*h);
+	SDL_SetRenderTarget(window->ren, texture);
+	SDL_RenderReadPixels(window->ren, NULL, SDL_PIXELFORMAT_RGBA8888, pixels.data(), w * 4);
+	SDL_SetRenderTarget(window->ren, NULL);
+	return pixels;
+}
+
+static void readChunks(const unordered_map<int, TileChunk> &cache, Window *window, unordered_map<int, vector<Uint32>> &out)
+{
+	for (auto &i : cache) out[i.first] = readTexture(i.second.tex, window);
+}
+
+//cached chunks, redrawn cell by cell since they were made, against chunks drawn in full for the same view
+//static layer chunks too, changeLayerTile drops the edited ones and animated cells are redrawn in place
+//returns differing chunks, checked counts the chunks compared
+unsigned checkChunks(Tilemap &map, Window *window, unsigned &checked)
+{
+	unordered_map<int, vector<Uint32>> before;
+	readChunks(map.chunks, window, before);
+	vector<unordered_map<int, vector<Uint32>>> layersBefore(map.layers.size());
+	for (size_t i = 0; i < map.layers.size(); i++) readChunks(map.layers[i].chunks, window, layersBefore[i]);
+
+	//redraw everything visible, without letting animated tiles step to their next frame in between
+	vector<unsigned> counters;
+	for (auto &i : map.animations)
+	{
+		counters.push_back(i.second.counter);
+		i.second.counter = UINT_MAX;
+	}
+	map.clearChunks();
+	map.update(window);
+	size_t n = 0;
+	for (auto &i : map.animations) i.second.counter = counters[n++];
+
+	unsigned bad = 0;
+	checked = 0;
+	auto compare = [&](const unordered_map<int, TileChunk> &cache, const unordered_map<int, vector<Uint32>> &old)
+	{
+		for (auto &i : cache)
+		{
+			auto it = old.find(i.first);
+			if (it == old.end()) continue;
+			checked++;
+			if (readTexture(i.second.tex, window) != it->second) bad++;
+		}
+	};
+	compare(map.chunks, before);
+	for (size_t i = 0; i < map.layers.size(); i++) compare(map.layers[i].chunks, layersBefore[i]);
+	return bad;
+}
+
+static vector<char> readFile(const string &file)
+{
+	ifstream in(file.c_str(), ios::in | ios::binary);
+	return vector<char>((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+static bool sameMap(const Tilemap &a, const Tilemap &b)
+{
+	if (a.tileRes != b.tileRes || a.vertiTiles != b.vertiTiles || a.horiTiles != b.horiTiles || a.bitMapName != b.bitMapName) return false;
+	if (a.tiles != b.tiles || a.layers.size() != b.layers.size() || a.animations.size() != b.animations.size()) return false;
+	for (size_t i = 0; i < a.layers.size(); i++)
+	{
+		const TileLayer &x = a.layers[i];
+		const TileLayer &y = b.layers[i];
+		if (x.tiles != y.tiles || x.scrollX != y.scrollX || x.scrollY != y.scrollY || x.isStatic != y.isStatic || x.foreground != y.foreground) return false;
+	}
+	for (auto &i : a.animations)
+	{
+		auto it = b.animations.find(i.first);
+		if (it == b.animations.end() || it->second.frames != i.second.frames || it->second.frameDelay != i.second.frameDelay) return false;
+	}
+	return true;
+}
+
+//saves the map raw and compressed to file, loads both back and saves them again
+//the loaded maps have to match, the second saves have to repeat the first byte for byte and a damaged tile section must not load
+//returns the failed steps, rawSize and rleSize are the sizes of the two files
+unsigned checkSaveLoad(Tilemap &map, const string &file, size_t &rawSize, size_t &rleSize)
+{
+	unsigned bad = 0;
+	rawSize = rleSize = 0;
+	for (int compress = 0; compress < 2; compress++)
+	{
+		Tilemap loaded(map.sprites);
+		if (!map.saveFile(file, compress != 0) || !loaded.loadFile(file))
+		{
+			bad++;
+			continue;
+		}
+		vector<char> saved = readFile(file);
+		(compress ? rleSize : rawSize) = saved.size();
+		if (!sameMap(map, loaded)) bad++;
+		if (!loaded.saveFile(file, compress != 0) || readFile(file) != saved) bad++;
+
+		//the tile section comes right after the info section, flip a byte in its payload
+		size_t tileData = 8 + 12 + (sizeof(map.tileRes) + 2 * sizeof(int) + map.bitMapName.size() + 1) + 12 + 1;
+		if (tileData < saved.size())
+		{
+			saved[tileData] ^= 0x5a;
+			ofstream out(file.c_str(), ios::out | ios::binary);
+			out.write(saved.data(), saved.size());
+			out.close();
+			if (loaded.loadFile(file)) bad++;
+		}
+	}
+	remove(file.c_str());
+
+	//runs of the same tile are what the levels are made of
+	if (rleSize >= rawSize) bad++;
+	return bad;
+}
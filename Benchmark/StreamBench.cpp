@@ -0,0 +1,182 @@
+//streaming benchmark: builds a world file far bigger than the memory budget, flies a screen sized view across it
+//prefetching the chunks around the view, and prints the cost per frame, misses and peak resident memory as JSON
+//the view is drawn from a Tilemap of the area around it, paged in with loadRegion whenever the view nears its edge,
+//and checked against the store
+//usage: bench stream [-w tiles] [-h tiles] [-frames n] [-speed tiles] [-budget mb] [-threads n] [-seed n] [-world file]
+//without -world the world file is written to stream.wld and removed afterwards
+
+#include "TileStore.h"
+#include "Tilemap.h"
+#include "JobSystem.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+using namespace std;
+using namespace std::chrono;
+
+double percentile(vector<double> values, double q);
+
+//rolling ground: sky above, a band of dirt with caves and scenery, solid rock below
+//everything away from the surface comes out as uniform chunks
+static int surfaceAt(int x, int height)
+{
+	return height / 2 + int(48 * sin(x*0.004) + 12 * sin(x*0.031));
+}
+
+int runStreamBench(int argc, char *argv[])
+{
+	int width = 65536;
+	int height = 4096;
+	int frames = 2000;
+	int speed = 2;		//tiles per frame
+	int budgetMB = 8;
+	int threads = 1;
+	unsigned seed = 1;
+	string world;
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		string arg = argv[i];
+		if (arg == "-w") width = atoi(argv[i + 1]);
+		else if (arg == "-h") height = atoi(argv[i + 1]);
+		else if (arg == "-frames") frames = atoi(argv[i + 1]);
+		else if (arg == "-speed") speed = atoi(argv[i + 1]);
+		else if (arg == "-budget") budgetMB = atoi(argv[i + 1]);
+		else if (arg == "-threads") threads = atoi(argv[i + 1]);
+		else if (arg == "-seed") seed = (unsigned)atoi(argv[i + 1]);
+		else if (arg == "-world") world = argv[i + 1];
+		else
+		{
+			cerr << "unknown option " << arg << endl;
+			return 1;
+		}
+	}
+	if (width < 256 || height < 256 || frames < 1 || speed < 0 || budgetMB < 1)
+	{
+		cerr << "world must be at least 256x256 tiles, frames and budget positive" << endl;
+		return 1;
+	}
+	bool keep = !world.empty();
+	if (!keep) world = "stream.wld";
+
+	//log output of the store goes to stderr, stdout is reserved for the results
+	streambuf *coutBuffer = cout.rdbuf(cerr.rdbuf());
+
+	steady_clock::time_point buildStart = steady_clock::now();
+	bool built = TileStore::build(world, 32, height, width, "../Platform/testpic.png", [&](int chunkX, int chunkY, char *tiles)
+	{
+		const int size = TileStore::CHUNK_SIZE;
+		mt19937 rng(seed ^ (chunkY * 65599u + chunkX));
+		for (int x = 0; x < size; x++)
+		{
+			int surface = surfaceAt(chunkX*size + x, height);
+			for (int y = 0; y < size; y++)
+			{
+				int depth = chunkY*size + y - surface;
+				char type = 0;
+				if (depth >= 96) type = 1;
+				else if (depth >= 0) type = rng() % 5 ? 1 : (rng() % 2 ? 0 : char(2 + rng() % 8));
+				tiles[y*size + x] = type;
+			}
+		}
+	});
+	double buildTime = duration<double>(steady_clock::now() - buildStart).count();
+	if (!built) return 1;
+
+	unique_ptr<JobSystem> jobs;
+	if (threads > 0) jobs.reset(new JobSystem(threads));
+
+	TileStore store(jobs.get());
+	store.budget = (size_t)budgetMB << 20;
+	if (!store.open(world)) return 1;
+
+	//the view is a screen of tiles, chunks are wanted a chunk ahead of it on every side
+	const int viewW = 32;
+	const int viewH = 18;
+	const int margin = TileStore::CHUNK_SIZE;
+	vector<double> times(frames);
+	vector<double> regionTimes;
+	size_t peak = 0;
+	unsigned checksum = 0;
+	unsigned mismatches = 0;
+
+	//the region is the prefetched area, so it's mostly resident by the time it's loaded
+	Tilemap region;
+	int regionX = 0;
+	int regionY = 0;
+	const int regionW = viewW + 2*margin;
+	const int regionH = viewH + 2*margin;
+	const int edge = 8;		//tiles between the view and the edge of the region that trigger the next one
+
+	for (int frame = 0; frame < frames; frame++)
+	{
+		steady_clock::time_point start = steady_clock::now();
+
+		int x = (frame*speed) % (width - viewW);
+		int y = min(max(surfaceAt(x, height) - viewH / 2, 0), height - viewH);
+		store.prefetch(x - margin, y - margin, x + viewW + margin - 1, y + viewH + margin - 1);
+		store.poll();
+
+		if (frame == 0 || x - regionX < edge || y - regionY < edge
+			|| regionX + regionW - (x + viewW) < edge || regionY + regionH - (y + viewH) < edge)
+		{
+			steady_clock::time_point regionStart = steady_clock::now();
+			regionX = x - margin;
+			regionY = y - margin;
+			region.loadRegion(store, regionX, regionY, regionW, regionH);
+			regionTimes.push_back(duration<double, micro>(steady_clock::now() - regionStart).count());
+		}
+
+		//what drawing the view reads
+		for (int j = 0; j < viewH; j++)
+		{
+			for (int i = 0; i < viewW; i++)
+			{
+				char type = region.getTile(x - regionX + i, y - regionY + j);
+				if (type != store.getTile(x + i, y + j)) mismatches++;
+				checksum += (Uint8)type;
+			}
+		}
+
+		times[frame] = duration<double, micro>(steady_clock::now() - start).count();
+		peak = max(peak, store.residentBytes);
+	}
+
+	unsigned misses = store.misses;
+	store.close();
+	FILE *file = fopen(world.c_str(), "rb");
+	long fileSize = 0;
+	if (file)
+	{
+		fseek(file, 0, SEEK_END);
+		fileSize = ftell(file);
+		fclose(file);
+	}
+	if (!keep) remove(world.c_str());
+	cout.rdbuf(coutBuffer);
+
+	cout << "{" << endl;
+	cout << "\t\"world\": { \"width\": " << width << ", \"height\": " << height << ", \"tiles\": " << (double)width*height
+		<< ", \"file_bytes\": " << fileSize << ", \"build_s\": " << buildTime << " }," << endl;
+	cout << "\t\"frames\": " << frames << "," << endl;
+	cout << "\t\"threads\": " << threads << "," << endl;
+	cout << "\t\"budget_bytes\": " << ((size_t)budgetMB << 20) << "," << endl;
+	cout << "\t\"peak_resident_bytes\": " << peak << "," << endl;
+	cout << "\t\"misses\": " << misses << "," << endl;
+	cout << "\t\"checksum\": " << checksum << "," << endl;
+	cout << "\t\"mismatches\": " << mismatches << "," << endl;
+	cout << "\t\"unit\": \"us\"," << endl;
+	cout << "\t\"frame\": { \"p50\": " << percentile(times, 0.5) << ", \"p99\": " << percentile(times, 0.99)
+		<< ", \"max\": " << *max_element(times.begin(), times.end()) << " }," << endl;
+	cout << "\t\"region\": { \"loads\": " << regionTimes.size() << ", \"size\": [" << regionW << ", " << regionH
+		<< "], \"p50\": " << percentile(regionTimes, 0.5) << ", \"max\": " << *max_element(regionTimes.begin(), regionTimes.end()) << " }" << endl;
+	cout << "}" << endl;
+	return mismatches ? 1 : 0;
+}
@@ -0,0 +1,463 @@
+//headless frame benchmark: runs the game loop stages on a generated map with scripted input
+//and prints per-stage timings as JSON, so regressions can be tracked without a display or a GPU
+//uses SDL's dummy video driver and the software renderer
+//
+//builds from the sources here plus every source in ../Platform except its main.cpp, on Linux for example:
+//	g++ -O2 -I../Platform main.cpp GhostBench.cpp StreamBench.cpp MapChecks.cpp $(ls ../Platform/*.cpp | grep -v main.cpp) -lSDL2 -lSDL2_image -o bench
+//usage: bench [-w tiles] [-h tiles] [-frames n] [-entities n] [-characters n] [-seed n] [-sheet file] [-threads n] [-batched 0|1] [-wrapped 0|1] [-layers n] [-trace file] [-replay file] [-animated 0|1] [-edits n]
+//	or bench ghosts ... for the ghost decision microbenchmark, see GhostBench.cpp
+//	or bench stream ... for streaming tiles of a large world from disk, see StreamBench.cpp
+
+#include "Window.h"
+#include "Tilemap.h"
+#include "Character.h"
+#include "EntityStore.h"
+#include "GhostKernel.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include "InputLog.h"
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <string>
+#include <cstdlib>
+#include <cmath>
+
+#ifdef main
+#undef main
+#endif
+
+using namespace std;
+using namespace std::chrono;
+
+const int SCREEN_WIDTH = 32*32;
+const int SCREEN_HEIGHT = 32*18;
+const double TICK_TIME = 1.0 / 120.0;
+
+enum Stage
+{
+	STAGE_INPUT,
+	STAGE_PHYSICS,
+	STAGE_COLLISION,
+	STAGE_EDIT,
+	STAGE_MAP_UPDATE,
+	STAGE_MAP_RENDER,
+	STAGE_ENTITIES,
+	STAGE_PRESENT,
+	STAGE_FRAME,		//whole frame, sum of the above
+	STAGE_COUNT
+};
+
+const char *stageNames[STAGE_COUNT] = { "input", "physics", "collision", "edit", "map_update", "map_render", "entities", "present", "frame" };
+
+struct BenchOptions
+{
+	int width;
+	int height;
+	int frames;
+	int entities;		//ghosts roaming the screen
+	int characters;		//runners besides the player, stepped together with it
+	unsigned seed;
+	string sheet;
+	int threads;		//the simulation passes run on a job system with this many workers, 0 runs them on the main thread
+	bool batched;		//draw the map as one batch from the atlas instead of through the chunk cache
+	bool wrapped;		//draw the map through the wrap-around scrolling texture
+	int layers;			//static parallax layers behind the main tiles
+	string trace;		//if set, stages and zones are also written there as a Chrome trace
+	string replay;		//input recorded with the game's -record instead of the scripted input, restarts when it runs out
+	bool animated;		//decorative tiles cycle through sprite frames
+	int edits;			//tiles changed around the player every frame, and as many layer tiles, checked against rebuilding from scratch at the end
+};
+
+//solid border and floor, random platforms and blocks, decorative tiles in between
+void generateMap(Tilemap &map, const BenchOptions &options)
+{
+	map.create(32, options.height, options.width, options.sheet);
+	mt19937 rng(options.seed);
+
+	for (int y = 0; y < map.vertiTiles; y++)
+	{
+		for (int x = 0; x < map.horiTiles; x++)
+		{
+			char type = rng() % 8 == 0 ? char(2 + rng() % 8) : 0;
+			if (x == 0 || y == 0 || x == map.horiTiles - 1 || y >= map.vertiTiles - 2) type = 1;
+			map.tiles[y*map.horiTiles + x] = type;
+		}
+	}
+
+	//platforms every few rows, kept away from the spawn column
+	for (int y = 6; y < map.vertiTiles - 4; y += 5)
+	{
+		for (int x = 8 + rng() % 8; x < map.horiTiles - 8; x += 10 + rng() % 16)
+		{
+			int length = 3 + rng() % 6;
+			for (int i = 0; i < length && x + i < map.horiTiles - 1; i++)
+			{
+				map.tiles[y*map.horiTiles + x + i] = 1;
+			}
+		}
+	}
+
+	//scenery behind the level, sparser and slower the further back it is
+	for (int i = 0; i < options.layers; i++)
+	{
+		float scroll = 1.0f / (options.layers - i + 1);
+		TileLayer &layer = map.addLayer(scroll, scroll, true, false);
+		for (auto &tile : layer.tiles)
+		{
+			if (rng() % 4 == 0) tile = char(2 + rng() % 8);
+		}
+	}
+
+	map.buildSolidIndex();
+
+	//every decorative type cycles through the next few sheet frames, each at its own pace
+	if (options.animated)
+	{
+		unsigned frames = map.sprites->size();
+		for (char type = 2; type < 10; type++)
+		{
+			vector<char> sequence;
+			for (unsigned i = 0; i < 4; i++) sequence.push_back(char((type + i) % frames));
+			map.animateTile(type, sequence, 4 + type);
+		}
+	}
+}
+
+//the screen is an open maze for the ghosts: they turn only on whole tiles and never leave it
+static void openDirections(const EntityStore &entities, unsigned first, unsigned last, Uint8 *available)
+{
+	for (unsigned i = first; i < last; i++)
+	{
+		int x = entities.x[i];
+		int y = entities.y[i];
+		int tileRes = entities.tileRes[i];
+		Uint8 direction = entities.direction[i];
+		if (x % tileRes || y % tileRes)
+		{
+			available[i] = direction | oppositeTable[direction];
+			continue;
+		}
+
+		Uint8 open = NONE;
+		if (y >= tileRes) open |= UP;
+		if (y + 2*tileRes <= SCREEN_HEIGHT) open |= DOWN;
+		if (x >= tileRes) open |= LEFT;
+		if (x + 2*tileRes <= SCREEN_WIDTH) open |= RIGHT;
+		available[i] = open;
+	}
+}
+
+//run until blocked, then turn around, and jump every so often
+static void scriptedInput(Character &runner, int phase, const Tilemap &map)
+{
+	if (runner.velocity.x > 0.0 && runner.scanBoundary(RIGHT, map) < 0.0001) runner.velocity.x = -runner.runSpeed;
+	else if (runner.velocity.x < 0.0 && runner.scanBoundary(LEFT, map) < 0.0001) runner.velocity.x = runner.runSpeed;
+	if (!runner.freeFall && phase % 90 < 20) runner.jump();
+	else if (runner.airBorne) runner.freeFall = true;
+}
+
+//scanBoundary against sweeping the hitbox across the map, for the four directions, returns how many disagree
+//boxes already overlapping a solid tile are left out, sweep ignores those tiles on purpose
+static unsigned checkScan(Character &runner, const Tilemap &map, unsigned &checked)
+{
+	double left = double(runner.position.x - runner.origin.x);
+	double top = double(runner.position.y - runner.origin.y);
+	double w = runner.rect.w;
+	double h = runner.rect.h;
+	int res = map.tileRes;
+	if (map.solidInArea(int(floor(left / res)), int(floor(top / res)), int(ceil((left + w) / res)) - 1, int(ceil((top + h) / res)) - 1)) return 0;
+
+	double far = double(max(map.horiTiles, map.vertiTiles)*res);
+	Direction directions[4] = { UP, DOWN, LEFT, RIGHT };
+	unsigned bad = 0;
+	for (Direction direction : directions)
+	{
+		double dx = direction == RIGHT ? far : direction == LEFT ? -far : 0.0;
+		double dy = direction == DOWN ? far : direction == UP ? -far : 0.0;
+		SweepHit hit = map.sweep(left, top, w, h, dx, dy);
+		if (hit.time >= 1.0) continue;
+
+		checked++;
+		if (fabs(double(runner.scanBoundary(direction, map)) - hit.time*far) > 0.001) bad++;
+	}
+	return bad;
+}
+
+double percentile(vector<double> values, double q)
+{
+	sort(values.begin(), values.end());
+	size_t index = size_t(q*(values.size() - 1) + 0.5);
+	return values[index];
+}
+
+int runGhostBench(int argc, char *argv[]);
+int runStreamBench(int argc, char *argv[]);
+unsigned checkSolidIndex(Tilemap &map);
+unsigned checkChunks(Tilemap &map, Window *window, unsigned &checked);
+unsigned checkSaveLoad(Tilemap &map, const string &file, size_t &rawSize, size_t &rleSize);
+
+int main(int argc, char *argv[])
+{
+	if (argc > 1 && string(argv[1]) == "ghosts") return runGhostBench(argc - 1, argv + 1);
+	if (argc > 1 && string(argv[1]) == "stream") return runStreamBench(argc - 1, argv + 1);
+
+	BenchOptions options = { 1024, 256, 2000, 64, 64, 1, "../Platform/testpic.png", 0, false, false, 0, "", "", false, 4 };
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		string arg = argv[i];
+		if (arg == "-w") options.width = atoi(argv[i + 1]);
+		else if (arg == "-h") options.height = atoi(argv[i + 1]);
+		else if (arg == "-frames") options.frames = atoi(argv[i + 1]);
+		else if (arg == "-entities") options.entities = atoi(argv[i + 1]);
+		else if (arg == "-characters") options.characters = atoi(argv[i + 1]);
+		else if (arg == "-seed") options.seed = (unsigned)atoi(argv[i + 1]);
+		else if (arg == "-sheet") options.sheet = argv[i + 1];
+		else if (arg == "-threads") options.threads = atoi(argv[i + 1]);
+		else if (arg == "-batched") options.batched = atoi(argv[i + 1]) != 0;
+		else if (arg == "-wrapped") options.wrapped = atoi(argv[i + 1]) != 0;
+		else if (arg == "-layers") options.layers = atoi(argv[i + 1]);
+		else if (arg == "-trace") options.trace = argv[i + 1];
+		else if (arg == "-replay") options.replay = argv[i + 1];
+		else if (arg == "-animated") options.animated = atoi(argv[i + 1]) != 0;
+		else if (arg == "-edits") options.edits = atoi(argv[i + 1]);
+		else
+		{
+			cerr << "unknown option " << arg << endl;
+			return 1;
+		}
+	}
+	if (options.width < 16 || options.height < 8 || options.frames < 1 || options.entities < 0 || options.characters < 0 || options.edits < 0)
+	{
+		cerr << "map must be at least 16x8 tiles, frames positive and counts not negative" << endl;
+		return 1;
+	}
+
+	SDL_SetHint(SDL_HINT_VIDEODRIVER, "dummy");
+	if (SDL_Init(SDL_INIT_VIDEO) < 0)
+	{
+		cerr << "SDL could not initialize! SDL Error: " << SDL_GetError() << endl;
+		return 1;
+	}
+	if (!(IMG_Init(IMG_INIT_PNG) & IMG_INIT_PNG))
+	{
+		cerr << "SDL_image could not initialize! SDL_image Error: " << IMG_GetError() << endl;
+		return 1;
+	}
+
+	//log output of the game code goes to stderr, stdout is reserved for the results
+	streambuf *coutBuffer = cout.rdbuf(cerr.rdbuf());
+
+	int result = 0;
+	{
+		Window window;
+		if (!window.init("Benchmark", SCREEN_WIDTH, SCREEN_HEIGHT, SDL_RENDERER_SOFTWARE | SDL_RENDERER_TARGETTEXTURE)) return 1;
+
+		Spritesheet sprites(options.sheet, 32, &window);
+		Spritesheet entitySprites(options.sheet, 32, &window, true, true);	//turned frames, so entities face where they go
+		Tilemap map(&sprites);
+		map.batched = options.batched;
+		map.wrapped = options.wrapped;
+		generateMap(map, options);
+
+		//the player comes first, the other runners start spread over the floor
+		vector<Character> characters(1 + options.characters);
+		for (unsigned i = 0; i < characters.size(); i++)
+		{
+			Character &runner = characters[i];
+			runner.gravity = 5000.0;
+			runner.runSpeed = 500.0;
+			runner.jumpVelocity = 800.0;
+			runner.jumpHeightMax = 128.0;
+			runner.terminalVelocity = 1024.0;
+			runner.rect.w = 32;
+			runner.rect.h = 64;
+			runner.origin.x = (double)(runner.rect.w / 2);
+			runner.origin.y = (double)runner.rect.h;
+			runner.position.x = (3 + int(i*37) % (map.horiTiles - 5))*32 + runner.origin.x;
+			runner.position.y = (map.vertiTiles - 2)*32.0;
+			runner.lastPosition = runner.position;
+			runner.rect.x = int(runner.position.x - runner.origin.x);
+			runner.rect.y = int(runner.position.y - runner.origin.y);
+			runner.velocity.x = i % 2 ? -runner.runSpeed : runner.runSpeed;
+		}
+		Character &player = characters[0];
+
+		unique_ptr<JobSystem> jobs;
+		if (options.threads > 0) jobs.reset(new JobSystem(options.threads));
+
+		EntityStore entities;
+		entities.reserve(options.entities);
+		mt19937 rng(options.seed);
+		for (int i = 0; i < options.entities; i++)
+		{
+			EntityRef entity = entities.get(entities.create(&entitySprites, 5));
+			entity.move(rng() % (SCREEN_WIDTH / 32 - 1) * 32, rng() % (SCREEN_HEIGHT / 32 - 1) * 32);
+			entity.speed() = 2;
+			entity.currentFrame() = rng() % entitySprites.size();
+		}
+
+		InputLog recording;
+		if (!options.replay.empty() && !recording.load(options.replay)) return 1;
+
+		//the entities are ghosts chasing the player in the middle of the screen, heading home or fleeing
+		Uint8 modes[3] = { CHASE, SCATTER, AFRAID };
+		vector<Uint8> available(options.entities), ghostMode(options.entities);
+		vector<int> targetX(options.entities, SCREEN_WIDTH / 2), targetY(options.entities, SCREEN_HEIGHT / 2);
+		vector<int> homeX = entities.x, homeY = entities.y;
+		vector<Uint32> ghostRng(options.entities);
+		for (int i = 0; i < options.entities; i++)
+		{
+			ghostMode[i] = modes[i % 3];
+			ghostRng[i] = recording.ticks ? recording.seedFor(i) : i + 1;	//a replay is random the way the recording was
+		}
+		GhostLanes ghosts = { entities.direction.data(), available.data(), ghostMode.data(), nullptr, entities.x.data(), entities.y.data(),
+			targetX.data(), targetY.data(), homeX.data(), homeY.data(), ghostRng.data(), (unsigned)options.entities };
+
+		vector<double> times[STAGE_COUNT];
+		for (auto &i : times) i.reserve(options.frames);
+
+		Profiler &profiler = Profiler::get();
+		profiler.setEnabled(!options.trace.empty());
+
+		unsigned scansChecked = 0;
+		unsigned scanMismatches = 0;
+
+		for (int frame = 0; frame < options.frames; frame++)
+		{
+			profiler.beginFrame();
+			steady_clock::time_point frameStart = steady_clock::now();
+			steady_clock::time_point last = frameStart;
+			Uint64 zoneStart = profiler.now();
+			auto lap = [&](Stage stage)
+			{
+				steady_clock::time_point now = steady_clock::now();
+				times[stage].push_back(duration<double, micro>(now - last).count());
+				last = now;
+
+				if (!profiler.isEnabled()) return;
+				Uint64 zoneEnd = profiler.now();
+				profiler.record(stageNames[stage], zoneStart, zoneEnd, 0);
+				zoneStart = zoneEnd;
+			};
+
+			if (recording.ticks)
+			{
+				//recorded input, mapped to the player the same way the game does it
+				if (recording.finished()) recording.rewind();
+				Uint8 buttons = recording.next();
+				if (buttons & INPUT_LEFT) player.velocity.x = -player.runSpeed;
+				else if (buttons & INPUT_RIGHT) player.velocity.x = player.runSpeed;
+				else player.velocity.x = 0.0;
+				if (!player.freeFall && (buttons & INPUT_JUMP)) player.jump();
+				else if (player.airBorne) player.freeFall = true;
+			}
+			else scriptedInput(player, frame, map);
+			for (unsigned i = 1; i < characters.size(); i++) scriptedInput(characters[i], frame + i*7, map);
+			lap(STAGE_INPUT);
+
+			moveCharacters(characters.data(), characters.size(), TICK_TIME, map, jobs.get());
+			lap(STAGE_PHYSICS);
+
+			bool colliding = checkMapCollision(player, map);
+			lap(STAGE_COLLISION);
+
+			//digging and building around the player, random types so tiles turn solid and free
+			for (int i = 0; i < options.edits; i++)
+			{
+				int x = min(max(player.rect.x / 32 + int(rng() % 33) - 16, 0), map.horiTiles - 1);
+				int y = min(max(player.rect.y / 32 + int(rng() % 19) - 9, 0), map.vertiTiles - 1);
+				map.changeTile(x, y, char(rng() % 10));
+
+				//and the scenery around the middle of where each layer is seen
+				if (!map.layers.empty())
+				{
+					unsigned layer = rng() % map.layers.size();
+					float scroll = map.layers[layer].scrollX;
+					x = min(max(int((window.offsetX*scroll + SCREEN_WIDTH / 2) / 32) + int(rng() % 33) - 16, 0), map.horiTiles - 1);
+					y = min(max(int((window.offsetY*scroll + SCREEN_HEIGHT / 2) / 32) + int(rng() % 19) - 9, 0), map.vertiTiles - 1);
+					map.changeLayerTile(layer, x, y, rng() % 4 ? EMPTY_TILE : char(2 + rng() % 8));
+				}
+			}
+			lap(STAGE_EDIT);
+
+			//camera follows the player
+			window.offsetX = player.rect.x - SCREEN_WIDTH / 2;
+			window.offsetY = player.rect.y - SCREEN_HEIGHT / 2;
+			map.update(&window);
+			lap(STAGE_MAP_UPDATE);
+
+			SDL_SetRenderDrawColor(window.ren, 0, 0, 0, 255);
+			SDL_RenderClear(window.ren);
+			map.render(&window);
+			lap(STAGE_MAP_RENDER);
+
+			if (jobs) jobs->parallelFor(ghosts.count, 4096, [&](unsigned first, unsigned last) { openDirections(entities, first, last, available.data()); });
+			else openDirections(entities, 0, ghosts.count, available.data());
+			navigateGhosts(ghosts, jobs.get());
+			entities.moveAll(jobs.get());
+			entities.updateTileAll(jobs.get());
+			entities.animateAll(jobs.get());
+			entities.renderAll(&window);
+			lap(STAGE_ENTITIES);
+
+			if (colliding) SDL_SetRenderDrawColor(window.ren, 0, 0, 255, 255);
+			else SDL_SetRenderDrawColor(window.ren, 255, 0, 0, 255);
+			SDL_Rect playerRect = player.interpolate(1.0);
+			SDL_RenderFillRect(window.ren, &playerRect);
+			map.renderForeground(&window);
+			SDL_RenderPresent(window.ren);
+			lap(STAGE_PRESENT);
+
+			times[STAGE_FRAME].push_back(duration<double, micro>(last - frameStart).count());
+			profiler.endFrame();
+
+			//scriptedInput turns runners around by scanBoundary, untimed
+			for (auto &i : characters) scanMismatches += checkScan(i, map, scansChecked);
+		}
+
+		if (!options.trace.empty()) profiler.exportTrace(options.trace);
+
+		//the edits went through the incremental paths, see that they ended up where rebuilding gets
+		unsigned solidMismatches = checkSolidIndex(map);
+		unsigned chunksChecked;
+		unsigned chunkMismatches = checkChunks(map, &window, chunksChecked);
+		size_t rawSize, rleSize;
+		unsigned saveMismatches = checkSaveLoad(map, "benchmark.map", rawSize, rleSize);
+		if (solidMismatches || chunkMismatches || saveMismatches || scanMismatches) result = 1;
+		cout.rdbuf(coutBuffer);
+
+		cout << "{" << endl;
+		cout << "\t\"map\": { \"width\": " << options.width << ", \"height\": " << options.height << " }," << endl;
+		cout << "\t\"frames\": " << options.frames << "," << endl;
+		cout << "\t\"entities\": " << options.entities << "," << endl;
+		cout << "\t\"characters\": " << options.characters << "," << endl;
+		cout << "\t\"threads\": " << options.threads << "," << endl;
+		cout << "\t\"batched\": " << (options.batched ? "true" : "false") << "," << endl;
+		cout << "\t\"wrapped\": " << (options.wrapped ? "true" : "false") << "," << endl;
+		cout << "\t\"layers\": " << options.layers << "," << endl;
+		cout << "\t\"animated\": " << (options.animated ? "true" : "false") << "," << endl;
+		cout << "\t\"edits\": " << options.edits << "," << endl;
+		cout << "\t\"checks\": { \"solid_index_mismatches\": " << solidMismatches << ", \"chunks\": " << chunksChecked
+			<< ", \"chunk_mismatches\": " << chunkMismatches << ", \"save_raw_bytes\": " << rawSize << ", \"save_rle_bytes\": " << rleSize
+			<< ", \"save_mismatches\": " << saveMismatches << ", \"scans\": " << scansChecked << ", \"scan_mismatches\": " << scanMismatches << " }," << endl;
+		cout << "\t\"unit\": \"us\"," << endl;
+		cout << "\t\"stages\": {" << endl;
+		for (int i = 0; i < STAGE_COUNT; i++)
+		{
+			cout << "\t\t\"" << stageNames[i] << "\": { \"p50\": " << percentile(times[i], 0.5)
+				<< ", \"p99\": " << percentile(times[i], 0.99)
+				<< ", \"max\": " << *max_element(times[i].begin(), times[i].end()) << " }"
+				<< (i + 1 < STAGE_COUNT ? "," : "") << endl;
+		}
+		cout << "\t}" << endl;
+		cout << "}" << endl;
+	}
+
+	IMG_Quit();
+	SDL_Quit();
+	return result;
+}
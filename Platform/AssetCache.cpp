@@ -0,0 +1,98 @@
+#include "AssetCache.h"
+#include "SheetLoader.h"
+
+using namespace std;
+
+AssetCache::AssetCache(Window *_window, size_t _budget)
+{
+	window = _window;
+	budget = _budget;
+	residentBytes = 0;
+	loader = nullptr;
+	useCounter = 0;
+}
+
+AssetCache::~AssetCache()
+{
+	for (auto &i : entries)
+	{
+		if (i.second.refs) cout << "Sheet " << i.first.c_str() << " still in use" << endl;
+	}
+}
+
+Spritesheet* AssetCache::acquire(const string &file, int tileRes, bool useAtlas, bool rotations)
+{
+	//the same image sliced differently is a different set of textures
+	string key = file + "|" + to_string(tileRes) + (useAtlas ? "|atlas" : "|frames") + (rotations ? "|rotations" : "");
+
+	auto it = entries.find(key);
+	if (it != entries.end())
+	{
+		it->second.refs++;
+		it->second.lastUsed = ++useCounter;
+		return it->second.sheet.get();
+	}
+
+	Entry &entry = entries[key];
+	entry.sheet.reset(new Spritesheet(useAtlas, rotations));
+	entry.refs = 1;
+	entry.lastUsed = ++useCounter;
+	entry.loaded = false;
+	keys[entry.sheet.get()] = key;
+
+	if (loader)
+	{
+		loader->request(entry.sheet.get(), file, tileRes, [this, key](Spritesheet*, bool) { sheetLoaded(key); });
+	}
+	else
+	{
+		entry.sheet->makeSheet(file, tileRes, window);
+		sheetLoaded(key);
+	}
+	return entry.sheet.get();
+}
+
+void AssetCache::sheetLoaded(const string &key)
+{
+	Entry &entry = entries[key];
+	entry.loaded = true;
+	residentBytes += entry.sheet->textureBytes;
+	trim();
+}
+
+void AssetCache::release(Spritesheet *sheet)
+{
+	auto key = keys.find(sheet);
+	if (key == keys.end()) return;
+
+	Entry &entry = entries[key->second];
+	if (entry.refs > 0) entry.refs--;
+	entry.lastUsed = ++useCounter;
+	trim();
+}
+
+bool AssetCache::isLoaded(const Spritesheet *sheet) const
+{
+	auto key = keys.find(sheet);
+	if (key == keys.end()) return false;
+	return entries.at(key->second).loaded;
+}
+
+void AssetCache::trim()
+{
+	while (residentBytes > budget)
+	{
+		//oldest sheet nobody holds, sheets still loading can't be evicted since the loader writes into them
+		auto oldest = entries.end();
+		for (auto it = entries.begin(); it != entries.end(); ++it)
+		{
+			if (it->second.refs || !it->second.loaded) continue;
+			if (oldest == entries.end() || it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+		}
+		if (oldest == entries.end()) return;
+
+		residentBytes -= oldest->second.sheet->textureBytes;
+		keys.erase(oldest->second.sheet.get());
+		entries.erase(oldest);
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Spritesheet.h"
+#include <memory>
+#include <unordered_map>
+
+class SheetLoader;
+
+//sprite sheets shared by file name, so every map and entity using an image gets the same textures
+//sheets are reference counted, ones nobody uses stay resident until the texture budget needs the room
+//which lets a level transition pick up whatever the previous level already loaded
+class AssetCache
+{
+public:
+	AssetCache(Window *_window, size_t _budget = 256 << 20);
+	~AssetCache();
+
+	//sheet for file, loaded if it isn't resident yet, every acquire needs a release
+	//asking again while the sheet is still loading returns the same sheet instead of loading it twice
+	Spritesheet* acquire(const string &file, int tileRes, bool useAtlas = true, bool rotations = false);
+	void release(Spritesheet *sheet);	//sheets that didn't come from the cache are ignored
+	bool isLoaded(const Spritesheet *sheet) const;
+	void trim();	//evict least recently used unreferenced sheets until under budget
+	inline unsigned size() const { return entries.size(); }
+
+	size_t budget;			//texture memory in bytes, sheets still in use are never evicted so it can be exceeded
+	size_t residentBytes;
+	Window *window;
+	SheetLoader *loader;	//optional, with it sheets load in the background and are empty until uploaded
+
+private:
+	struct Entry
+	{
+		unique_ptr<Spritesheet> sheet;
+		int refs;
+		unsigned lastUsed;
+		bool loaded;
+	};
+
+	void sheetLoaded(const string &key);
+
+	unordered_map<string, Entry> entries;
+	unordered_map<const Spritesheet*, string> keys;		//sheet -> key in entries
+	unsigned useCounter;
+};
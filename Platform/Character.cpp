@@ -0,0 +1,279 @@
+#include "Character.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+Character::Character()
+{
+	velocity.x = 0.0;
+	velocity.y = 0.0;
+	gravity = 0.0;
+	runSpeed = 0.0;
+	jumpVelocity = 0.0;
+	jumpHeight = 0.0;
+	jumpHeightMax = 0.0;
+	terminalVelocity = 0.0;
+	position.x = 0.0;
+	position.y = 0.0;
+	lastPosition.x = 0.0;
+	lastPosition.y = 0.0;
+	origin.x = 0.0;
+	origin.y = 0.0;
+	//bounds.left = 0.0;
+	//bounds.right = 0.0;
+	//bounds.up = 0.0;
+	//bounds.down = 0.0;
+	rect.x = 0;
+	rect.y = 0;
+	rect.w = 0;
+	rect.h = 0;
+	airBorne = false;
+	freeFall = false;
+}
+
+void Character::move(double deltaTime, const Tilemap& map)
+{
+	PROFILE_ZONE("Character::move");
+	lastPosition = position;
+
+	scalar dt = deltaTime;
+
+	//hitbox in pixels
+	scalar left = position.x - origin.x;
+	scalar top = position.y - origin.y;
+
+	//walked off a ledge
+	if (!airBorne && map.sweep(left, top, rect.w, rect.h, 0.0, 1.0).time > 0.0001)
+	{
+		airBorne = true;
+		freeFall = true;
+	}
+
+	scalarVector step;
+	step.x = velocity.x * dt;
+	step.y = airBorne ? velocity.y * dt : scalar(0);
+
+	if (airBorne && velocity.y < 0.0 && !freeFall)	//actively jumping
+	{
+		if (jumpHeight >= jumpHeightMax)	//max jump
+		{
+			jumpHeight = 0.0;
+			freeFall = true;
+		}
+		else jumpHeight -= step.y;
+	}
+
+	//sweep the whole step at once so nothing is tunneled through however long it is,
+	//on contact the rest of the step slides along the surface, a corner can stop both axes
+	for (int i = 0; i < 3 && (step.x != 0.0 || step.y != 0.0); i++)
+	{
+		auto hit = map.sweep(left, top, rect.w, rect.h, step.x, step.y);
+		left = hit.x;
+		top = hit.y;
+		if (!hit.normalX && !hit.normalY) break;
+
+		step.x *= 1.0 - hit.time;
+		step.y *= 1.0 - hit.time;
+		if (hit.normalX) step.x = 0.0;
+		if (hit.normalY)
+		{
+			step.y = 0.0;
+			jumpHeight = 0.0;
+			velocity.y = 0.0;
+			if (hit.normalY < 0)	//landing
+			{
+				airBorne = false;
+				freeFall = false;
+			}
+			else freeFall = true;	//hit ceiling
+		}
+	}
+
+	if (airBorne && freeFall && velocity.y < terminalVelocity)	//gravity
+	{
+		velocity.y = min(velocity.y + gravity * dt, terminalVelocity);
+	}
+
+	position.x = left + origin.x;
+	position.y = top + origin.y;
+	rect.x = int(left);	//truncation is fine
+	rect.y = int(top);
+}
+
+void Character::jump()
+{
+	airBorne = true;
+	velocity.y = -jumpVelocity;
+}
+
+SDL_Rect Character::interpolate(double alpha) const
+{
+	SDL_Rect rc = rect;
+	rc.x = int(lastPosition.x + (position.x - lastPosition.x)*alpha - origin.x);
+	rc.y = int(lastPosition.y + (position.y - lastPosition.y)*alpha - origin.y);
+	return rc;
+}
+
+scalar Character::scanDistance(scalar edge, const Tilemap& map, Direction direction, intVector firstTile, intVector lastTile)
+{
+	scalar distance = 0;
+
+	//for each occupied tile, look up how far a ray can go in desired direction
+	//keep the smallest value
+	int minDist = 1000000;
+	for (int i = firstTile.y; i <= lastTile.y; i++)
+	{
+		for (int j = firstTile.x; j <= lastTile.x; j++)
+		{
+			minDist = min(minDist, map.solidDistance(j, i, direction));
+		}
+	}
+
+	//indices of the first tile the ray can't enter
+	int xi = firstTile.x;
+	int yi = firstTile.y;
+	switch (direction)
+	{
+	case LEFT:	xi -= minDist;	break;
+	case RIGHT:	xi += minDist;	break;
+	case UP:	yi -= minDist;	break;
+	case DOWN:	yi += minDist;	break;
+	default:	return 0;
+	}
+
+	switch (direction)
+	{
+	case LEFT:	distance = edge - (xi + 1)*map.tileRes;	break;
+	case RIGHT:	distance = xi*map.tileRes - edge;		break;
+	case UP:	distance = edge - (yi + 1)*map.tileRes;	break;
+	case DOWN:	distance = yi*map.tileRes - edge;		break;
+	default:	break;
+	}
+
+	return distance < 0 ? scalar(0) : distance;
+}
+
+scalar Character::scanBoundary(Direction direction, const Tilemap& map)
+{
+	PROFILE_ZONE("Character::scanBoundary");
+	//scanner's shape is simplified: find every tile which scanner's hitbox overlaps with
+	//get the first and last indices of these tiles in both axes, from the exact box, rect is truncated
+	//and would miss a tile the box reaches a fraction of a pixel into
+	double left = double(position.x - origin.x);
+	double top = double(position.y - origin.y);
+	int x1 = int(floor(left / map.tileRes));
+	int x2 = int(ceil((left + rect.w) / map.tileRes)) - 1;
+	int y1 = int(floor(top / map.tileRes));
+	int y2 = int(ceil((top + rect.h) / map.tileRes)) - 1;
+
+	intVector tile1;
+	intVector tile2;
+
+	scalar edge; //position of the relevant edge of the hitbox
+	switch (direction)
+	{
+	case LEFT:
+	{
+		edge = position.x - origin.x;
+		tile1 = { x1,y1 };
+		tile2 = { x1,y2 };
+		break;
+	}
+	case RIGHT:
+	{
+		edge = position.x - origin.x + rect.w;
+		tile1 = { x2,y1 };
+		tile2 = { x2,y2 };
+		break;
+	}
+	case UP:
+	{
+		edge = position.y - origin.y;
+		tile1 = { x1,y1 };
+		tile2 = { x2,y1 };
+		break;
+	}
+	case DOWN:
+	{
+		edge = position.y - origin.y + rect.h;
+		tile1 = { x1,y2 };
+		tile2 = { x2,y2 };
+		break;
+	}
+	default: return 0.0;
+	}
+
+	//get maximum distance scanner can travel direction
+	return scanDistance(edge, map, direction, tile1, tile2);
+}
+
+void moveCharacters(Character *characters, unsigned count, double deltaTime, const Tilemap& map, JobSystem *jobs)
+{
+	auto moveRange = [=, &map](unsigned first, unsigned last)
+	{
+		for (unsigned i = first; i < last; i++) characters[i].move(deltaTime, map);
+	};
+
+	if (jobs) jobs->parallelFor(count, 64, moveRange);
+	else moveRange(0, count);
+}
+
+bool checkMapCollision(const Character& scanner, const Tilemap& map)
+{
+	int x1 = scanner.rect.x / map.tileRes;
+	int x2 = (scanner.rect.x + scanner.rect.w - 1) / map.tileRes;
+	int y1 = scanner.rect.y / map.tileRes;
+	int y2 = (scanner.rect.y + scanner.rect.h - 1) / map.tileRes;
+
+	return map.solidInArea(x1, y1, x2, y2);
+}
+
+//hitboxes are processed in blocks so the tile bounds fit in fixed size arrays on the stack
+static const unsigned COLLISION_BLOCK = 64;
+
+void checkMapCollision(const int *x, const int *y, const int *w, const int *h, unsigned count, const Tilemap& map, Uint8 *hits)
+{
+	int x1[COLLISION_BLOCK], x2[COLLISION_BLOCK], y1[COLLISION_BLOCK], y2[COLLISION_BLOCK];
+	int tileRes = map.tileRes;
+
+	for (unsigned first = 0; first < count; first += COLLISION_BLOCK)
+	{
+		unsigned n = min(count - first, COLLISION_BLOCK);
+
+		//independent arithmetic per hitbox, this loop vectorizes
+		for (unsigned i = 0; i < n; i++)
+		{
+			x1[i] = x[first + i] / tileRes;
+			x2[i] = (x[first + i] + w[first + i] - 1) / tileRes;
+			y1[i] = y[first + i] / tileRes;
+			y2[i] = (y[first + i] + h[first + i] - 1) / tileRes;
+		}
+
+		//each row is tested 64 tiles at a time against the solid mask
+		for (unsigned i = 0; i < n; i++)
+		{
+			hits[first + i] = map.solidInArea(x1[i], y1[i], x2[i], y2[i]);
+		}
+	}
+}
+
+void checkMapCollision(const SDL_Rect *rects, unsigned count, const Tilemap& map, Uint8 *hits)
+{
+	int x[COLLISION_BLOCK], y[COLLISION_BLOCK], w[COLLISION_BLOCK], h[COLLISION_BLOCK];
+
+	for (unsigned first = 0; first < count; first += COLLISION_BLOCK)
+	{
+		unsigned n = min(count - first, COLLISION_BLOCK);
+		for (unsigned i = 0; i < n; i++)
+		{
+			x[i] = rects[first + i].x;
+			y[i] = rects[first + i].y;
+			w[i] = rects[first + i].w;
+			h[i] = rects[first + i].h;
+		}
+		checkMapCollision(x, y, w, h, n, map, hits + first);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Tilemap.h"
+
+class JobSystem;
+
+struct intVector
+{
+	int x;
+	int y;
+};
+
+//the number type of the physics, defining PLATFORM_FIXED_PHYSICS makes it fixed point
+//so the simulation comes out bit for bit the same on every machine, for lockstep and replays
+#ifdef PLATFORM_FIXED_PHYSICS
+typedef Fixed scalar;
+#else
+typedef double scalar;
+#endif
+
+struct scalarVector
+{
+	scalar x;
+	scalar y;
+};
+
+class Character
+{
+public:
+	Character();
+	void move(double deltaTime, const Tilemap& map);
+	void jump();
+	SDL_Rect interpolate(double alpha) const;	//hitbox between the last two simulation steps, for rendering
+	scalar scanDistance(scalar edge, const Tilemap& map, Direction direction, intVector firstTile, intVector lastTile);
+	scalar scanBoundary(Direction direction, const Tilemap& map);
+
+	scalarVector velocity;
+	scalar gravity;
+	scalar runSpeed;
+	scalar airSpeed;
+	scalar jumpVelocity;
+	scalar jumpHeight;
+	scalar jumpHeightMax;
+	scalar terminalVelocity;
+	scalarVector position;
+	scalarVector lastPosition;	//position before the latest move
+	scalarVector origin;
+
+	SDL_Rect rect;
+
+	bool airBorne;
+	bool freeFall;
+};
+
+//steps every character, characters only read the map so with a job system they're moved in parallel
+void moveCharacters(Character *characters, unsigned count, double deltaTime, const Tilemap& map, JobSystem *jobs = nullptr);
+
+bool checkMapCollision(const Character& scanner, const Tilemap& map);	//does the hitbox overlap any solid tile
+
+//the same test for many hitboxes at once, hits[i] is set to 1 or 0
+void checkMapCollision(const SDL_Rect *rects, unsigned count, const Tilemap& map, Uint8 *hits);
+void checkMapCollision(const int *x, const int *y, const int *w, const int *h, unsigned count, const Tilemap& map, Uint8 *hits);
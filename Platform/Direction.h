@@ -0,0 +1,11 @@
+#pragma once
+
+//directions are bit flags so sets of them (e.g. available exits) fit in one value
+enum Direction
+{
+	NONE = 0,
+	UP = 1,
+	DOWN = 2,
+	LEFT = 4,
+	RIGHT = 8
+};
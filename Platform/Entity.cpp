@@ -1,9 +1,13 @@
 #include "Entity.h"
+#include <cmath>
 
 Entity::Entity()
 {
 	x = 0;
 	y = 0;
+	tileX = 0;
+	tileY = 0;
+	grid = nullptr;
 	sprites = nullptr;
 	frameDelay = 0;
 	direction = NONE;
@@ -18,18 +22,64 @@ Entity::Entity(Spritesheet *_sprites, unsigned _frameDelay)
 {
 	x = 0;
 	y = 0;
+	tileX = 0;
+	tileY = 0;
+	grid = nullptr;
 	sprites = _sprites;
 	frameDelay = _frameDelay;
 	direction = NONE;
+	nextDirection = NONE;
 	speed = 0;
 	counter = _frameDelay;
 	currentFrame = 0;
 	animForward = true;
 }
 
-Entity::~Entity()
+Entity::Entity(const Entity &other)
+{
+	x = other.x;
+	y = other.y;
+	tileX = other.tileX;
+	tileY = other.tileY;
+	grid = nullptr;
+	sprites = other.sprites;
+	frameDelay = other.frameDelay;
+	direction = other.direction;
+	nextDirection = other.nextDirection;
+	speed = other.speed;
+	counter = other.counter;
+	currentFrame = other.currentFrame;
+	animForward = other.animForward;
+}
+
+Entity& Entity::operator=(const Entity &other)
 {
+	if (this == &other) return *this;
+
+	//leave with the old tile, come back with the new one
+	SpatialHash *oldGrid = grid;
+	if (oldGrid) oldGrid->remove(this);
+
+	x = other.x;
+	y = other.y;
+	tileX = other.tileX;
+	tileY = other.tileY;
+	sprites = other.sprites;
+	frameDelay = other.frameDelay;
+	direction = other.direction;
+	nextDirection = other.nextDirection;
+	speed = other.speed;
+	counter = other.counter;
+	currentFrame = other.currentFrame;
+	animForward = other.animForward;
+
+	if (oldGrid) oldGrid->insert(this);
+	return *this;
+}
 
+Entity::~Entity()
+{
+	if (grid) grid->remove(this);
 }
 
 void Entity::move()
@@ -57,7 +107,7 @@ void Entity::render(Window *window)
 	rc.y = y;
 	rc.h = rc.w = sprites->tileRes;
 
-	SDL_RenderCopy(window->ren, sprites->frames[currentFrame], NULL, &rc);
+	SDL_RenderCopy(window->ren, sprites->getTexture(currentFrame), sprites->getClip(currentFrame), &rc);
 }
 
 void Entity::renderRotated(Window *window)
@@ -67,17 +117,28 @@ void Entity::renderRotated(Window *window)
 	rc.y = y;
 	rc.h = rc.w = sprites->tileRes;
 
-	int angle;
+	//quarter turns clockwise from facing right
+	int turns;
 	switch (direction)
 	{
-	case RIGHT:	angle = 0;	break;
-	case DOWN: angle = 90; rc.x--;	break;
-	case LEFT: angle = 180; rc.y--;	break;
-	case UP: angle = 270;	break;
-	default: angle = 0; break;
+	case RIGHT:	turns = 0;	break;
+	case DOWN: turns = 1;	break;
+	case LEFT: turns = 2;	break;
+	case UP: turns = 3;	break;
+	default: turns = 0; break;
 	}
 
-	SDL_RenderCopyEx(window->ren, sprites->frames[currentFrame], NULL, &rc, angle, NULL, SDL_FLIP_NONE);
+	if (sprites->rotations)
+	{
+		SDL_RenderCopy(window->ren, sprites->getTexture(currentFrame, turns), sprites->getClip(currentFrame), &rc);
+	}
+	else
+	{
+		//sheet loaded without rotations, let the renderer turn it, which lands a pixel off for these two
+		if (turns == 1) rc.x--;
+		else if (turns == 2) rc.y--;
+		SDL_RenderCopyEx(window->ren, sprites->getTexture(currentFrame), sprites->getClip(currentFrame), &rc, turns * 90, NULL, SDL_FLIP_NONE);
+	}
 }
 
 void Entity::animateLoop()
@@ -88,7 +149,7 @@ void Entity::animateLoop()
 		counter = frameDelay;
 
 		currentFrame++;
-		if (currentFrame == sprites->frames.size()) currentFrame = 0;
+		if (currentFrame == sprites->size()) currentFrame = 0;
 	}
 }
 
@@ -100,7 +161,7 @@ void Entity::animatePong()
 		counter = frameDelay;
 
 		if (currentFrame == 0) animForward = true;
-		if (currentFrame == sprites->frames.size() - 1)  animForward = false;
+		if (currentFrame == sprites->size() - 1)  animForward = false;
 
 		if (animForward) currentFrame++;
 		else currentFrame--;
@@ -129,8 +190,12 @@ void Entity::updateDirection()
 
 void Entity::updateTile()
 {
-	tileX = x / sprites->tileRes;
-	tileY = y / sprites->tileRes;
+	int oldX = tileX;
+	int oldY = tileY;
+	tileX = floorDiv(x, sprites->tileRes);
+	tileY = floorDiv(y, sprites->tileRes);
+
+	if (grid && (tileX != oldX || tileY != oldY)) grid->move(this, oldX, oldY);
 }
 
 bool Entity::checkAlignment()
@@ -140,7 +205,7 @@ bool Entity::checkAlignment()
 	//else return chaotic evil
 }
 
-int Entity::distance(Entity target)
+int Entity::distance(const Entity &target) const
 {
 	int deltaX = target.x - x;
 	int deltaY = target.y - y;
@@ -148,7 +213,27 @@ int Entity::distance(Entity target)
 	return int(sqrt(deltaX*deltaX + deltaY*deltaY) + 0.5);
 }
 
-void Ghost::setTarget(Entity target)
+Ghost::Ghost() : Entity()
+{
+	isActive = false;
+	homeX = homeY = 0;
+	targetX = targetY = 0;
+	mode = INACTIVE;
+	flow = nullptr;
+	rngState = 0x2545F491;
+}
+
+Ghost::Ghost(Spritesheet *_sprites, unsigned _frameDelay) : Entity(_sprites, _frameDelay)
+{
+	isActive = false;
+	homeX = homeY = 0;
+	targetX = targetY = 0;
+	mode = INACTIVE;
+	flow = nullptr;
+	rngState = 0x2545F491;
+}
+
+void Ghost::setTarget(const Entity &target)
 {
 	targetX = target.x;
 	targetY = target.y;
@@ -157,80 +242,34 @@ void Ghost::setTarget(Entity target)
 
 void Ghost::navigate(Direction directions)
 {
-	Direction opposite = NONE;
-	if (direction)
+	Uint8 preferred = NONE;
+	if (flow && (mode == CHASE || mode == SCATTER))
 	{
-		switch (direction)
-		{
-		case UP:	opposite = DOWN;	break;
-		case DOWN:	opposite = UP;		break;
-		case LEFT:	opposite = RIGHT;	break;
-		case RIGHT:	opposite = LEFT;	break;
-		}
-
-		directions = (Direction)(directions & ~opposite);
-
-		if (directions == NONE) directions = opposite;
+		int res = sprites->tileRes;
+		if (mode == CHASE) preferred = flow->next(floorDiv(x, res), floorDiv(y, res), floorDiv(targetX, res), floorDiv(targetY, res));
+		else preferred = flow->next(floorDiv(x, res), floorDiv(y, res), floorDiv(homeX, res), floorDiv(homeY, res));
 	}
 
-	switch (directions)
-	{
-	case UP:	direction = UP;		return;
-	case DOWN:	direction = DOWN;	return;
-	case LEFT:	direction = LEFT;	return;
-	case RIGHT:	direction = RIGHT;	return;
-	default: break;
-	}
-
-	switch (mode)
-	{
-	case INACTIVE:														break;
-	case CHASE:		direction = chase(targetX, targetY, directions);	break;
-	case SCATTER:	direction = chase(homeX, homeY, directions);		break;
-	case AFRAID:	direction = flee(directions);						break;
-	case HOME:															break;
-	}
+	int goalX = mode == SCATTER ? homeX : targetX;
+	int goalY = mode == SCATTER ? homeY : targetY;
+	direction = (Direction)decideDirection(direction, directions, mode, goalX - x, goalY - y, preferred, rngState);
 }
 
 Direction Ghost::chase(int _x, int _y, Direction directions)
 {
-	int deltaX = _x - x;
-	int deltaY = _y - y;
-
-	vector<Direction> choices;
-	choices.push_back(RIGHT);
-	choices.push_back(DOWN);
-	choices.push_back(LEFT);
-	choices.push_back(UP);
-
-	//arrange directions from best to worst
-	if (deltaX < 0)
-		swap(choices[0], choices[2]);
-	if (deltaY < 0)
-		swap(choices[1], choices[3]);
-	if (abs(deltaX) < abs(deltaY))
+	//follow the shortest path when there is one
+	if (flow)
 	{
-		swap(choices[0], choices[1]);
-		swap(choices[2], choices[3]);
+		int res = sprites->tileRes;
+		Direction best = flow->next(floorDiv(x, res), floorDiv(y, res), floorDiv(_x, res), floorDiv(_y, res));
+		if (best & directions) return best;
 	}
 
-	//pick best one available
-	for (auto &i : choices)
-	{
-		if (i & directions) return i;
-	}
-	cout << "error" << endl;
-	return NONE;
+	//best available direction, NONE if there are none
+	return (Direction)chaseDirection(_x - x, _y - y, directions);
 }
 
 Direction Ghost::flee(Direction directions)
 {
-	vector<Direction> choices;
-	if (directions & UP)	choices.push_back(UP);
-	if (directions & DOWN)	choices.push_back(DOWN);
-	if (directions & LEFT)	choices.push_back(LEFT);
-	if (directions & RIGHT)	choices.push_back(RIGHT);
-
-	if (choices.size() == 1) return choices.front();
-	else return choices[rand() % choices.size()];
+	return (Direction)fleeDirection(directions, rngState);
 }
\ No newline at end of file
@@ -1,24 +1,10 @@
 #pragma once
 
 #include "Spritesheet.h"
-
-enum Direction
-{
-	NONE = 0,
-	UP = 1,
-	DOWN = 2,
-	LEFT = 4,
-	RIGHT = 8
-};
-
-enum Chasemode
-{
-	INACTIVE,
-	CHASE,
-	SCATTER,
-	AFRAID,
-	HOME,
-};
+#include "Direction.h"
+#include "FlowField.h"
+#include "GhostKernel.h"
+#include "SpatialHash.h"
 
 class Entity
 {
@@ -26,6 +12,10 @@ public:
 
 	Entity();
 	Entity(Spritesheet *_sprites, unsigned _frameDelay);
+	//a grid holds pointers, so copies start outside of it and assigning keeps the target's place
+	//there are no moves, they copy
+	Entity(const Entity &other);
+	Entity& operator=(const Entity &other);
 	~Entity();
 
 	void move();				//move forward
@@ -36,9 +26,9 @@ public:
 	void animatePong();
 	void requestDirection(Direction _direction);
 	void updateDirection();		//change to requested direction
-	void updateTile();			//update tileX and tileY
+	void updateTile();			//update tileX and tileY, and the entity's place in grid
 	bool checkAlignment();		//perfect alignment with tile grid
-	int distance(Entity target);
+	int distance(const Entity &target) const;
 
 	//position in pixels
 	int x;
@@ -46,6 +36,7 @@ public:
 	//position in tiles
 	int tileX;
 	int tileY;
+	SpatialHash *grid;		//set by SpatialHash::insert
 	Spritesheet *sprites;
 	Direction direction;
 	Direction nextDirection;
@@ -59,6 +50,8 @@ public:
 class Ghost : public Entity
 {
 public:
+	Ghost();
+	Ghost(Spritesheet *_sprites, unsigned _frameDelay);
 
 	bool isActive;
 	int homeX;
@@ -66,13 +59,16 @@ public:
 	int targetX;
 	int targetY;
 	Chasemode mode;
+	FlowFields *flow;	//shared pathfinding, chasing falls back to heading straight for the target without it
+	Uint32 rngState;	//for fleeing, every ghost has its own so results don't depend on update order
 	//Direction(*chaseAlgorithm)(Direction);
 
 	inline void activate() { isActive = true; }
 	inline void deActivate() { isActive = false; }
-	void setTarget(Entity target);
+	void setTarget(const Entity &target);
 	void setScatter() { mode = SCATTER; }
 	void navigate(Direction directions);
 	Direction chase(int _x, int _y, Direction directions);
 	Direction flee(Direction directions);
+	void seed(Uint32 _seed) { rngState = _seed ? _seed : 1; }
 };
\ No newline at end of file
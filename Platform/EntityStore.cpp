@@ -0,0 +1,220 @@
+#include "EntityStore.h"
+#include "JobSystem.h"
+#include "SpatialHash.h"
+#include <climits>
+
+using namespace std;
+
+void EntityRef::requestDirection(Direction _direction)
+{
+	Uint8 &current = direction();
+	store->nextDirection[store->indexOf[id]] = _direction;
+	//if current and intended direction are exactly opposite, turn immediately
+	if (((current | _direction) == (UP | DOWN)) | ((current | _direction) == (LEFT | RIGHT)))
+	{
+		updateDirection();
+	}
+}
+
+void EntityRef::updateDirection()
+{
+	unsigned i = store->indexOf[id];
+	if (store->nextDirection[i] == NONE) return;
+	store->direction[i] = store->nextDirection[i];
+	store->nextDirection[i] = NONE;
+}
+
+unsigned EntityStore::create(Spritesheet *_sprites, unsigned _frameDelay)
+{
+	unsigned id;
+	if (freeIds.empty())
+	{
+		id = indexOf.size();
+		indexOf.push_back(0);
+	}
+	else
+	{
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	indexOf[id] = x.size();
+	idOf.push_back(id);
+
+	x.push_back(0);
+	y.push_back(0);
+	tileX.push_back(0);
+	tileY.push_back(0);
+	speed.push_back(0);
+	direction.push_back(NONE);
+	nextDirection.push_back(NONE);
+	frameDelay.push_back(_frameDelay);
+	counter.push_back(_frameDelay);
+	currentFrame.push_back(0);
+	frameCount.push_back(_sprites->size());
+	tileRes.push_back(_sprites->tileRes);
+	sprites.push_back(_sprites);
+
+	return id;
+}
+
+void EntityStore::destroy(unsigned id)
+{
+	//move the last entity into the freed slot so the arrays stay packed
+	unsigned i = indexOf[id];
+	unsigned last = x.size() - 1;
+
+	x[i] = x[last];
+	y[i] = y[last];
+	tileX[i] = tileX[last];
+	tileY[i] = tileY[last];
+	speed[i] = speed[last];
+	direction[i] = direction[last];
+	nextDirection[i] = nextDirection[last];
+	frameDelay[i] = frameDelay[last];
+	counter[i] = counter[last];
+	currentFrame[i] = currentFrame[last];
+	frameCount[i] = frameCount[last];
+	tileRes[i] = tileRes[last];
+	sprites[i] = sprites[last];
+	idOf[i] = idOf[last];
+	indexOf[idOf[i]] = i;
+
+	x.pop_back();
+	y.pop_back();
+	tileX.pop_back();
+	tileY.pop_back();
+	speed.pop_back();
+	direction.pop_back();
+	nextDirection.pop_back();
+	frameDelay.pop_back();
+	counter.pop_back();
+	currentFrame.pop_back();
+	frameCount.pop_back();
+	tileRes.pop_back();
+	sprites.pop_back();
+	idOf.pop_back();
+
+	indexOf[id] = UINT_MAX;
+	freeIds.push_back(id);
+}
+
+void EntityStore::reserve(unsigned count)
+{
+	x.reserve(count);
+	y.reserve(count);
+	tileX.reserve(count);
+	tileY.reserve(count);
+	speed.reserve(count);
+	direction.reserve(count);
+	nextDirection.reserve(count);
+	frameDelay.reserve(count);
+	counter.reserve(count);
+	currentFrame.reserve(count);
+	frameCount.reserve(count);
+	tileRes.reserve(count);
+	sprites.reserve(count);
+	idOf.reserve(count);
+}
+
+//entities per job, big enough that scheduling overhead doesn't show
+static const unsigned PASS_GRAIN = 4096;
+
+void EntityStore::moveAll(JobSystem *jobs)
+{
+	if (jobs) jobs->parallelFor(size(), PASS_GRAIN, [this](unsigned first, unsigned last) { moveRange(first, last); });
+	else moveRange(0, size());
+}
+
+void EntityStore::animateAll(JobSystem *jobs)
+{
+	if (jobs) jobs->parallelFor(size(), PASS_GRAIN, [this](unsigned first, unsigned last) { animateRange(first, last); });
+	else animateRange(0, size());
+}
+
+void EntityStore::updateTileAll(JobSystem *jobs)
+{
+	if (jobs) jobs->parallelFor(size(), PASS_GRAIN, [this](unsigned first, unsigned last) { updateTileRange(first, last); });
+	else updateTileRange(0, size());
+}
+
+//the passes below are branch free over plain arrays so the compiler can vectorize them
+
+void EntityStore::moveRange(unsigned first, unsigned last)
+{
+	int *px = x.data();
+	int *py = y.data();
+	const int *pSpeed = speed.data();
+	const Uint8 *pDirection = direction.data();
+	for (unsigned i = first; i < last; i++)
+	{
+		int d = pDirection[i];
+		int dx = ((d & RIGHT) != 0) - ((d & LEFT) != 0);
+		int dy = ((d & DOWN) != 0) - ((d & UP) != 0);
+		px[i] += dx*pSpeed[i];
+		py[i] += dy*pSpeed[i];
+	}
+}
+
+void EntityStore::animateRange(unsigned first, unsigned last)
+{
+	unsigned *pCounter = counter.data();
+	unsigned *pFrame = currentFrame.data();
+	const unsigned *pDelay = frameDelay.data();
+	const unsigned *pCount = frameCount.data();
+	for (unsigned i = first; i < last; i++)
+	{
+		unsigned step = pCounter[i] == 0;
+		pCounter[i] = step ? pDelay[i] : pCounter[i] - 1;
+		unsigned frame = pFrame[i] + step;
+		pFrame[i] = frame == pCount[i] ? 0 : frame;
+	}
+}
+
+void EntityStore::updateTileRange(unsigned first, unsigned last)
+{
+	const int *px = x.data();
+	const int *py = y.data();
+	const int *pRes = tileRes.data();
+	int *pTileX = tileX.data();
+	int *pTileY = tileY.data();
+	for (unsigned i = first; i < last; i++)
+	{
+		pTileX[i] = floorDiv(px[i], pRes[i]);
+		pTileY[i] = floorDiv(py[i], pRes[i]);
+	}
+}
+
+//quarter turns clockwise from facing right for every direction, like Entity::renderRotated
+static const int turnsOf[16] = { 0, 3, 1, 0, 2, 0, 0, 0, 0 };
+
+void EntityStore::renderAll(Window *window)
+{
+	SDL_Rect rc;
+	batch.begin(NULL);
+	for (unsigned i = 0; i < size(); i++)
+	{
+		rc.x = x[i];
+		rc.y = y[i];
+		rc.h = rc.w = tileRes[i];
+
+		//sheets without an atlas have a texture per frame and can't be batched
+		//sheets loaded with rotations face the way the entity is going
+		SDL_Texture *texture = sprites[i]->rotations ? sprites[i]->getTexture(currentFrame[i], turnsOf[direction[i] & 15]) : sprites[i]->getTexture(currentFrame[i]);
+		if (!sprites[i]->useAtlas)
+		{
+			batch.submit(window->ren);
+			batch.begin(NULL);
+			SDL_RenderCopy(window->ren, texture, NULL, &rc);
+			continue;
+		}
+
+		//keep draw order, so flush whenever the texture changes
+		if (texture != batch.texture)
+		{
+			batch.submit(window->ren);
+			batch.begin(texture);
+		}
+		batch.add(sprites[i]->getClip(currentFrame[i]), rc);
+	}
+	batch.submit(window->ren);
+}
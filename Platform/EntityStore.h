@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Spritesheet.h"
+#include "Direction.h"
+#include "SpriteBatch.h"
+
+class EntityStore;
+class JobSystem;
+
+//what gameplay code holds on to, stays valid while other entities are created and destroyed
+class EntityRef
+{
+public:
+	EntityRef(EntityStore *_store, unsigned _id) : store(_store), id(_id) {}
+
+	inline int& x();
+	inline int& y();
+	inline int tileX() const;
+	inline int tileY() const;
+	inline int& speed();
+	inline Uint8& direction();
+	inline unsigned& currentFrame();
+	inline void move(int _x, int _y) { x() = _x; y() = _y; }
+	void requestDirection(Direction _direction);
+	void updateDirection();		//change to requested direction
+
+	EntityStore *store;
+	unsigned id;
+};
+
+//the same data as Entity, kept in parallel arrays so the batched passes run over contiguous memory
+//index i is the same entity in every array, ids map to indices since destroying an entity moves the last one into its slot
+class EntityStore
+{
+public:
+	unsigned create(Spritesheet *_sprites, unsigned _frameDelay);	//returns the id of the new entity
+	void destroy(unsigned id);
+	inline EntityRef get(unsigned id) { return EntityRef(this, id); }
+	inline unsigned size() const { return x.size(); }
+	void reserve(unsigned count);
+
+	//with a job system the passes are split into slices that run in parallel, results are the same either way
+	void moveAll(JobSystem *jobs = nullptr);		//move everything forward
+	void animateAll(JobSystem *jobs = nullptr);		//same as Entity::animateLoop
+	void updateTileAll(JobSystem *jobs = nullptr);	//update tileX and tileY
+	void renderAll(Window *window);		//entities sharing an atlas go out in one draw call, turned to their direction if the sheet has rotations
+
+	//position in pixels
+	vector<int> x;
+	vector<int> y;
+	//position in tiles
+	vector<int> tileX;
+	vector<int> tileY;
+	vector<int> speed;
+	vector<Uint8> direction;
+	vector<Uint8> nextDirection;
+	//animation
+	vector<unsigned> frameDelay;
+	vector<unsigned> counter;
+	vector<unsigned> currentFrame;
+	vector<unsigned> frameCount;	//size of the sheet, copied so animateAll doesn't have to chase pointers
+	vector<int> tileRes;
+	vector<Spritesheet*> sprites;
+
+	vector<unsigned> indexOf;	//id -> index, UINT_MAX for destroyed ids
+	vector<unsigned> idOf;		//index -> id
+	vector<unsigned> freeIds;
+
+private:
+	SpriteBatch batch;		//kept between frames so its buffers are reused
+
+	void moveRange(unsigned first, unsigned last);
+	void animateRange(unsigned first, unsigned last);
+	void updateTileRange(unsigned first, unsigned last);
+};
+
+inline int& EntityRef::x() { return store->x[store->indexOf[id]]; }
+inline int& EntityRef::y() { return store->y[store->indexOf[id]]; }
+inline int EntityRef::tileX() const { return store->tileX[store->indexOf[id]]; }
+inline int EntityRef::tileY() const { return store->tileY[store->indexOf[id]]; }
+inline int& EntityRef::speed() { return store->speed[store->indexOf[id]]; }
+inline Uint8& EntityRef::direction() { return store->direction[store->indexOf[id]]; }
+inline unsigned& EntityRef::currentFrame() { return store->currentFrame[store->indexOf[id]]; }
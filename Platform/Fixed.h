@@ -0,0 +1,54 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+
+using namespace std;
+
+//fixed point number with 16 fractional bits, every operation is plain integer arithmetic
+//so results are the same on every compiler, optimization level and thread
+//the integer part is wide enough for positions in pixels on any map the distance tables allow
+class Fixed
+{
+public:
+	static const int FRACTION_BITS = 16;
+	static const Sint64 ONE = Sint64(1) << FRACTION_BITS;
+
+	Fixed() : raw(0) {}
+	Fixed(int value) : raw(Sint64(value) * ONE) {}
+	Fixed(double value) : raw(Sint64(value * ONE + (value < 0.0 ? -0.5 : 0.5))) {}	//nearest, only for constants and setup
+	static Fixed fromRaw(Sint64 raw) { Fixed f; f.raw = raw; return f; }
+	static Fixed max() { return fromRaw(INT64_MAX); }
+
+	explicit operator double() const { return double(raw) / ONE; }
+	explicit operator int() const { return int(raw / ONE); }	//towards zero like a double cast
+	int floor() const { return int(raw >> FRACTION_BITS); }
+
+	Fixed operator-() const { return fromRaw(-raw); }
+	Fixed& operator+=(Fixed b) { raw += b.raw; return *this; }
+	Fixed& operator-=(Fixed b) { raw -= b.raw; return *this; }
+	Fixed& operator*=(Fixed b) { raw = (raw * b.raw) >> FRACTION_BITS; return *this; }
+	Fixed& operator/=(Fixed b);
+
+	Sint64 raw;
+};
+
+inline Fixed operator+(Fixed a, Fixed b) { return a += b; }
+inline Fixed operator-(Fixed a, Fixed b) { return a -= b; }
+inline Fixed operator*(Fixed a, Fixed b) { return a *= b; }
+inline Fixed operator/(Fixed a, Fixed b) { return a /= b; }
+inline bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+inline bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+inline bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+inline bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+inline bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+inline bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+
+//rounds down instead of towards zero, so a tiny negative result doesn't turn into 0
+inline Fixed& Fixed::operator/=(Fixed b)
+{
+	Sint64 n = raw * ONE;
+	Sint64 q = n / b.raw;
+	if (n % b.raw && (n < 0) != (b.raw < 0)) q--;
+	raw = q;
+	return *this;
+}
@@ -0,0 +1,95 @@
+#include "FlowField.h"
+
+using namespace std;
+
+FlowFields::FlowFields(const Tilemap *_map)
+{
+	map = _map;
+	maxFields = 16;
+	solidVersion = _map->solidVersion;
+	useCounter = 0;
+}
+
+const FlowField& FlowFields::get(int targetX, int targetY)
+{
+	//fields are stale as soon as a tile becomes solid or free
+	if (solidVersion != map->solidVersion)
+	{
+		clear();
+		solidVersion = map->solidVersion;
+	}
+
+	useCounter++;
+	int target = targetY*map->horiTiles + targetX;
+	auto it = fields.find(target);
+	if (it != fields.end())
+	{
+		it->second.lastUsed = useCounter;
+		return it->second;
+	}
+
+	if (fields.size() >= maxFields)
+	{
+		auto oldest = fields.begin();
+		for (auto i = fields.begin(); i != fields.end(); ++i)
+		{
+			if (i->second.lastUsed < oldest->second.lastUsed) oldest = i;
+		}
+		fields.erase(oldest);
+	}
+
+	FlowField &field = fields[target];
+	field.lastUsed = useCounter;
+	compute(field, target);
+	return field;
+}
+
+Direction FlowFields::next(int x, int y, int targetX, int targetY)
+{
+	if (x < 0 || y < 0 || x >= map->horiTiles || y >= map->vertiTiles) return NONE;
+	if (targetX < 0 || targetY < 0 || targetX >= map->horiTiles || targetY >= map->vertiTiles) return NONE;
+
+	return (Direction)get(targetX, targetY).directions[y*map->horiTiles + x];
+}
+
+void FlowFields::clear()
+{
+	fields.clear();
+}
+
+void FlowFields::compute(FlowField &field, int target)
+{
+	int width = map->horiTiles;
+	int size = width*map->vertiTiles;
+
+	field.directions.assign(size, NONE);
+	visited.assign(size, false);
+	queue.resize(size);
+
+	//breadth first from the target, every tile reached points back at the tile it was reached from
+	int head = 0;
+	int tail = 0;
+	queue[tail++] = target;
+	visited[target] = true;
+
+	while (head < tail)
+	{
+		int in = queue[head++];
+		int x = in % width;
+
+		//neighbour and the direction that leads from it back to this tile
+		int neighbours[4] = { in - width, in + width, in - 1, in + 1 };
+		Direction back[4] = { DOWN, UP, RIGHT, LEFT };
+		bool inside[4] = { in >= width, in + width < size, x > 0, x < width - 1 };
+
+		for (int i = 0; i < 4; i++)
+		{
+			int n = neighbours[i];
+			if (!inside[i] || visited[n] || map->isSolid(map->tiles[n])) continue;
+
+			visited[n] = true;
+			field.directions[n] = back[i];
+			queue[tail++] = n;
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <unordered_map>
+#include "Tilemap.h"
+
+//for every tile, which way to go to reach one target tile along a shortest path
+struct FlowField
+{
+	vector<Uint8> directions;	//Direction per tile, NONE where the target can't be reached from
+	unsigned lastUsed;
+};
+
+//flow fields shared by everything chasing the same target tile
+//a field is computed with one BFS the first time its target is asked for and reused until the map's solid tiles change
+class FlowFields
+{
+public:
+	FlowFields(const Tilemap *_map);
+
+	const FlowField& get(int targetX, int targetY);		//target in tiles
+	Direction next(int x, int y, int targetX, int targetY);	//direction to take from tile x,y, NONE if there's no path
+	void clear();
+
+	const Tilemap *map;
+	unsigned maxFields;		//least recently used fields get dropped past this
+	unordered_map<int, FlowField> fields;	//keyed by target tile index
+	unsigned solidVersion;	//map's solidVersion the fields were computed for
+	unsigned useCounter;
+
+private:
+	void compute(FlowField &field, int target);
+
+	vector<int> queue;		//BFS scratch, kept around to avoid reallocating
+	vector<bool> visited;
+};
@@ -0,0 +1,22 @@
+#include "GhostKernel.h"
+#include "JobSystem.h"
+
+static void navigateRange(const GhostLanes &lanes, unsigned first, unsigned last)
+{
+	for (unsigned i = first; i < last; i++)
+	{
+		bool scatter = lanes.mode[i] == SCATTER;
+		int goalX = scatter ? lanes.homeX[i] : lanes.targetX[i];
+		int goalY = scatter ? lanes.homeY[i] : lanes.targetY[i];
+		Uint8 preferred = lanes.preferred ? lanes.preferred[i] : Uint8(NONE);
+
+		lanes.direction[i] = decideDirection(lanes.direction[i], lanes.available[i], lanes.mode[i],
+			goalX - lanes.x[i], goalY - lanes.y[i], preferred, lanes.rng[i]);
+	}
+}
+
+void navigateGhosts(const GhostLanes &lanes, JobSystem *jobs)
+{
+	if (jobs) jobs->parallelFor(lanes.count, 2048, [&lanes](unsigned first, unsigned last) { navigateRange(lanes, first, last); });
+	else navigateRange(lanes, 0, lanes.count);
+}
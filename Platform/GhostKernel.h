@@ -0,0 +1,126 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include "Direction.h"
+
+enum Chasemode
+{
+	INACTIVE,
+	CHASE,
+	SCATTER,
+	AFRAID,
+	HOME,
+};
+
+//ghost decisions as lookups into tables over the 4-bit direction mask
+//used by Ghost::navigate for one ghost and by navigateGhosts for many, no allocation or I/O either way
+
+//opposite of every direction in a mask
+constexpr Uint8 oppositeOf(int mask) { return Uint8(((mask & (UP | LEFT)) << 1) | ((mask & (DOWN | RIGHT)) >> 1)); }
+constexpr Uint8 countOf(int mask) { return mask ? Uint8((mask & 1) + countOf(mask >> 1)) : 0; }
+//n-th direction in the mask, in the order UP, DOWN, LEFT, RIGHT
+constexpr Uint8 nthOf(int mask, int n) { return mask == 0 ? Uint8(NONE) : n == 0 ? Uint8(mask & -mask) : nthOf(mask & (mask - 1), n - 1); }
+
+//chasing prefers directions in the order: closer axis towards, other axis towards, closer axis away, other axis away
+//key bit 0: target is to the left, bit 1: target is above, bit 2: target is further vertically than horizontally
+constexpr Uint8 towardsX(int key) { return (key & 1) ? LEFT : RIGHT; }
+constexpr Uint8 towardsY(int key) { return (key & 2) ? UP : DOWN; }
+constexpr Uint8 chaseOrder(int key, int i)
+{
+	return (key & 4)
+		? (i == 0 ? towardsY(key) : i == 1 ? towardsX(key) : i == 2 ? oppositeOf(towardsY(key)) : oppositeOf(towardsX(key)))
+		: (i == 0 ? towardsX(key) : i == 1 ? towardsY(key) : i == 2 ? oppositeOf(towardsX(key)) : oppositeOf(towardsY(key)));
+}
+constexpr Uint8 chaseChoice(int key, int mask, int i = 0)
+{
+	return i == 4 ? Uint8(NONE) : (chaseOrder(key, i) & mask) ? chaseOrder(key, i) : chaseChoice(key, mask, i + 1);
+}
+
+#define MASK_ROW(f) { f(0), f(1), f(2), f(3), f(4), f(5), f(6), f(7), f(8), f(9), f(10), f(11), f(12), f(13), f(14), f(15) }
+#define OPPOSITE(m) oppositeOf(m)
+#define COUNT(m) countOf(m)
+#define NTH(m) { nthOf(m, 0), nthOf(m, 1), nthOf(m, 2), nthOf(m, 3) }
+#define CHASE_ROW(key) { chaseChoice(key, 0), chaseChoice(key, 1), chaseChoice(key, 2), chaseChoice(key, 3), \
+	chaseChoice(key, 4), chaseChoice(key, 5), chaseChoice(key, 6), chaseChoice(key, 7), \
+	chaseChoice(key, 8), chaseChoice(key, 9), chaseChoice(key, 10), chaseChoice(key, 11), \
+	chaseChoice(key, 12), chaseChoice(key, 13), chaseChoice(key, 14), chaseChoice(key, 15) }
+
+static constexpr Uint8 oppositeTable[16] = MASK_ROW(OPPOSITE);
+static constexpr Uint8 countTable[16] = MASK_ROW(COUNT);
+static constexpr Uint8 nthTable[16][4] = MASK_ROW(NTH);
+static constexpr Uint8 chaseTable[8][16] = { CHASE_ROW(0), CHASE_ROW(1), CHASE_ROW(2), CHASE_ROW(3), CHASE_ROW(4), CHASE_ROW(5), CHASE_ROW(6), CHASE_ROW(7) };
+
+#undef MASK_ROW
+#undef OPPOSITE
+#undef COUNT
+#undef NTH
+#undef CHASE_ROW
+
+//xorshift32, state must not be 0
+inline Uint32 nextRandom(Uint32 &state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+inline Uint8 chaseDirection(int deltaX, int deltaY, Uint8 available)
+{
+	int absX = deltaX < 0 ? -deltaX : deltaX;
+	int absY = deltaY < 0 ? -deltaY : deltaY;
+	int key = (deltaX < 0) | ((deltaY < 0) << 1) | ((absX < absY) << 2);
+	return chaseTable[key][available & 15];
+}
+
+inline Uint8 fleeDirection(Uint8 available, Uint32 &rng)
+{
+	available &= 15;
+	if (countTable[available] < 2) return available;
+	return nthTable[available][nextRandom(rng) % countTable[available]];
+}
+
+//same rules as Ghost::navigate: never reverse unless it's the only way, take the only exit if there's one,
+//otherwise chase the goal or flee depending on mode
+//preferred is taken when it's open while chasing, e.g. from a flow field, NONE to ignore it
+inline Uint8 decideDirection(Uint8 direction, Uint8 available, Uint8 mode, int deltaX, int deltaY, Uint8 preferred, Uint32 &rng)
+{
+	Uint8 opposite = oppositeTable[direction & 15];
+	Uint8 open = available & 15 & ~opposite;
+	if (open == NONE) open = opposite;
+	if (countTable[open] == 1) return open;
+
+	switch (mode)
+	{
+	case CHASE:
+	case SCATTER:
+		if (preferred & open) return preferred;
+		return chaseDirection(deltaX, deltaY, open);
+	case AFRAID:
+		return fleeDirection(open, rng);
+	default:
+		return direction;
+	}
+}
+
+//a batch of ghosts as parallel arrays, index i is the same ghost in all of them
+struct GhostLanes
+{
+	Uint8 *direction;			//current direction in, chosen direction out
+	const Uint8 *available;		//open directions at the ghost's tile
+	const Uint8 *mode;			//Chasemode
+	const Uint8 *preferred;		//optional, see decideDirection
+	const int *x;				//position in pixels
+	const int *y;
+	const int *targetX;			//chased in CHASE mode
+	const int *targetY;
+	const int *homeX;			//chased in SCATTER mode
+	const int *homeY;
+	Uint32 *rng;				//per ghost random state
+	unsigned count;
+};
+
+class JobSystem;
+
+//with a job system, slices of the batch run in parallel, every ghost has its own random state so results don't change
+void navigateGhosts(const GhostLanes &lanes, JobSystem *jobs = nullptr);
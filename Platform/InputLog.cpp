@@ -0,0 +1,168 @@
+#include "InputLog.h"
+#include "MapFormat.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+
+using namespace std;
+
+static const char inputMagic[4] = { 'P', 'I', 'N', 'P' };
+static const Uint16 inputVersion = 1;
+
+InputLog::InputLog()
+{
+	seed = 0;
+	ticks = 0;
+	finalState = 0;
+	current = 0;
+	position = 0;
+	nextChange = 0;
+}
+
+void InputLog::startRecording(Uint32 _seed)
+{
+	seed = _seed;
+	ticks = 0;
+	finalState = 0;
+	changes.clear();
+	current = 0;
+}
+
+void InputLog::record(Uint8 buttons)
+{
+	if (buttons != current)
+	{
+		changes.push_back(Change{ ticks, buttons });
+		current = buttons;
+	}
+	ticks++;
+}
+
+bool InputLog::save(const string &file) const
+{
+	vector<char> out(inputMagic, inputMagic + sizeof(inputMagic));
+	writeValue(out, inputVersion);
+	writeValue(out, seed);
+	writeValue(out, ticks);
+	writeValue(out, finalState);
+	writeValue(out, (Uint32)changes.size());
+
+	Uint32 last = 0;
+	for (auto &i : changes)
+	{
+		//usually a handful of ticks between changes, so one byte
+		Uint32 delta = i.tick - last;
+		last = i.tick;
+		while (delta >= 0x80)
+		{
+			out.push_back(char((delta & 0x7f) | 0x80));
+			delta >>= 7;
+		}
+		out.push_back(char(delta));
+		out.push_back(char(i.buttons));
+	}
+
+	ofstream stream(file.c_str(), ios::out | ios::binary);
+	stream.write(out.data(), out.size());
+	stream.close();
+
+	if (!stream)
+	{
+		cout << "Saving " << file.c_str() << " failed" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool InputLog::load(const string &file)
+{
+	cout << "Loading " << file.c_str() << "... ";
+
+	ifstream stream(file.c_str(), ios::in | ios::binary | ios::ate);
+	if (!stream)
+	{
+		cout << "Loading failed" << endl;
+		return false;
+	}
+	vector<char> data((size_t)stream.tellg());
+	stream.seekg(0);
+	stream.read(data.data(), data.size());
+	stream.close();
+
+	const char *pos = data.data();
+	const char *end = pos + data.size();
+	auto read = [&](void *value, size_t size)
+	{
+		if ((size_t)(end - pos) < size) return false;
+		memcpy(value, pos, size);
+		pos += size;
+		return true;
+	};
+
+	char magic[4];
+	Uint16 version;
+	Uint32 count = 0;
+	bool ok = read(magic, 4) && !memcmp(magic, inputMagic, 4) && read(&version, 2) && version <= inputVersion
+		&& read(&seed, 4) && read(&ticks, 4) && read(&finalState, 8) && read(&count, 4);
+
+	changes.clear();
+	Uint32 tick = 0;
+	for (Uint32 i = 0; ok && i < count; i++)
+	{
+		Uint32 delta = 0;
+		Uint8 byte = 0x80;
+		for (int shift = 0; ok && (byte & 0x80); shift += 7)
+		{
+			ok = shift < 32 && read(&byte, 1);
+			delta |= Uint32(byte & 0x7f) << shift;
+		}
+
+		Change change;
+		ok = ok && read(&change.buttons, 1);
+		tick += delta;
+		change.tick = tick;
+		ok = ok && tick < ticks;
+		changes.push_back(change);
+	}
+
+	if (!ok)
+	{
+		changes.clear();
+		ticks = 0;
+	}
+
+	rewind();
+
+	cout << (ok ? "Ok" : "Loading failed") << endl;
+	return ok;
+}
+
+Uint8 InputLog::next()
+{
+	if (nextChange < changes.size() && changes[nextChange].tick == position)
+	{
+		current = changes[nextChange].buttons;
+		nextChange++;
+	}
+	position++;
+	return current;
+}
+
+Uint32 InputLog::seedFor(unsigned stream) const
+{
+	//murmur3 finalizer, neighbouring streams come out unrelated
+	Uint32 x = seed + stream * 0x9e3779b9u;
+	x ^= x >> 16;
+	x *= 0x85ebca6bu;
+	x ^= x >> 13;
+	x *= 0xc2b2ae35u;
+	x ^= x >> 16;
+	return x ? x : 1;
+}
+
+void InputLog::rewind()
+{
+	current = 0;
+	position = 0;
+	nextChange = 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//what the player is pressing during one simulation tick
+enum InputButton : Uint8
+{
+	INPUT_LEFT = 1,
+	INPUT_RIGHT = 2,
+	INPUT_JUMP = 4
+};
+
+//input of a whole session, one button state per tick, so a run can be played back exactly
+//only ticks where the state changes are stored, as the number of ticks since the last change and the new state
+//file layout: "PINP", Uint16 version, Uint32 seed, Uint32 ticks, Uint64 final state, Uint32 change count,
+//then per change a LEB128 tick delta and a Uint8 state
+class InputLog
+{
+public:
+	InputLog();
+
+	void startRecording(Uint32 _seed);	//anything random in the simulation has to be seeded from seed, see seedFor
+	void record(Uint8 buttons);			//once per tick
+	bool save(const string &file) const;
+	bool load(const string &file);
+
+	Uint8 next();		//buttons of the next tick when playing back
+	void rewind();		//play back from the start again
+	inline bool finished() const { return position >= ticks; }
+	Uint32 seedFor(unsigned stream) const;	//seed for one random state of the simulation, e.g. a ghost's, never 0
+
+	Uint32 seed;
+	Uint32 ticks;
+	Uint64 finalState;	//hash of the simulation after the last tick, for checking a replay ended up the same
+
+private:
+	struct Change
+	{
+		Uint32 tick;
+		Uint8 buttons;
+	};
+
+	vector<Change> changes;
+	Uint8 current;
+	Uint32 position;	//tick playback is at
+	size_t nextChange;
+};
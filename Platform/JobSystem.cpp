@@ -0,0 +1,144 @@
+#include "JobSystem.h"
+
+using namespace std;
+
+//pool the current thread works for and its index there, a thread of one pool is outside every other one
+struct WorkerSlot
+{
+	const JobSystem *owner;
+	int index;
+};
+static thread_local WorkerSlot worker = { nullptr, -1 };
+
+JobSystem::JobSystem(unsigned _workers)
+{
+	if (_workers == 0)
+	{
+		unsigned cores = thread::hardware_concurrency();
+		_workers = cores > 1 ? cores - 1 : 1;
+	}
+
+	nextQueue = 0;
+	queued = 0;
+	running = true;
+
+	for (unsigned i = 0; i < _workers; i++) queues.emplace_back(new WorkQueue);
+	for (unsigned i = 0; i < _workers; i++) threads.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		lock_guard<mutex> guard(sleepLock);
+		running = false;
+	}
+	wakeUp.notify_all();
+	for (auto &i : threads) i.join();
+}
+
+void JobSystem::submit(function<void()> work, JobCounter &counter)
+{
+	counter.pending++;
+
+	int own = workerIndex();
+	unsigned index = own >= 0 ? (unsigned)own : nextQueue++ % queues.size();
+	{
+		lock_guard<mutex> guard(queues[index]->lock);
+		queues[index]->jobs.push_back(Job{ move(work), &counter });
+	}
+
+	{
+		lock_guard<mutex> guard(sleepLock);
+		queued++;
+	}
+	wakeUp.notify_one();
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+	while (counter.pending > 0)
+	{
+		Job job;
+		if (take(job)) run(job);
+		else this_thread::yield();
+	}
+}
+
+void JobSystem::parallelFor(unsigned count, unsigned grain, const function<void(unsigned first, unsigned last)> &body)
+{
+	if (grain == 0) grain = 1;
+
+	JobCounter counter;
+	for (unsigned first = 0; first < count; first += grain)
+	{
+		unsigned last = count - first < grain ? count : first + grain;
+		submit([&body, first, last]() { body(first, last); }, counter);
+	}
+	wait(counter);
+}
+
+int JobSystem::workerIndex() const
+{
+	return worker.owner == this ? worker.index : -1;
+}
+
+bool JobSystem::pop(unsigned index, Job &job)
+{
+	WorkQueue &queue = *queues[index];
+	lock_guard<mutex> guard(queue.lock);
+	if (queue.jobs.empty()) return false;
+
+	job = move(queue.jobs.back());
+	queue.jobs.pop_back();
+	queued--;
+	return true;
+}
+
+bool JobSystem::steal(unsigned index, Job &job)
+{
+	for (unsigned i = 1; i <= queues.size(); i++)
+	{
+		WorkQueue &queue = *queues[(index + i) % queues.size()];
+		lock_guard<mutex> guard(queue.lock);
+		if (queue.jobs.empty()) continue;
+
+		job = move(queue.jobs.front());
+		queue.jobs.pop_front();
+		queued--;
+		return true;
+	}
+	return false;
+}
+
+bool JobSystem::take(Job &job)
+{
+	int own = workerIndex();
+	if (own >= 0) return pop(own, job) || steal(own, job);
+	return steal(0, job);
+}
+
+void JobSystem::run(Job &job)
+{
+	job.work();
+	job.counter->pending--;
+}
+
+void JobSystem::workerLoop(unsigned index)
+{
+	worker.owner = this;
+	worker.index = index;
+
+	while (true)
+	{
+		Job job;
+		if (pop(index, job) || steal(index, job))
+		{
+			run(job);
+			continue;
+		}
+
+		unique_lock<mutex> guard(sleepLock);
+		wakeUp.wait(guard, [this]() { return !running || queued > 0; });
+		if (!running) return;
+	}
+}
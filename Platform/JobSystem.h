@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+//counts the jobs of one batch that haven't finished yet
+struct JobCounter
+{
+	JobCounter() : pending(0) {}
+	atomic<int> pending;
+};
+
+struct Job
+{
+	function<void()> work;
+	JobCounter *counter;
+};
+
+//small work stealing scheduler: every worker has its own deque, takes its newest job from the back
+//and steals the oldest job from the front of another worker's deque when it runs out
+//waiting threads run jobs too, so waiting on work from inside a job can't deadlock
+class JobSystem
+{
+public:
+	JobSystem(unsigned _workers = 0);	//0 picks one less than the number of cores
+	~JobSystem();
+
+	void submit(function<void()> work, JobCounter &counter);
+	void wait(JobCounter &counter);		//helps out until every job counted by counter is done
+	//runs body over [0, count) in slices of at most grain and returns when all of them are done
+	void parallelFor(unsigned count, unsigned grain, const function<void(unsigned first, unsigned last)> &body);
+	inline unsigned size() const { return threads.size(); }
+
+private:
+	struct WorkQueue
+	{
+		mutex lock;
+		deque<Job> jobs;
+	};
+
+	int workerIndex() const;				//of the calling thread in this pool, -1 outside it
+	bool pop(unsigned index, Job &job);		//own queue, newest first
+	bool steal(unsigned index, Job &job);	//someone else's queue, oldest first
+	bool take(Job &job);					//whatever the calling thread can get
+	void run(Job &job);
+	void workerLoop(unsigned index);
+
+	vector<unique_ptr<WorkQueue>> queues;
+	vector<thread> threads;
+	atomic<unsigned> nextQueue;		//where jobs from threads outside the pool go
+	atomic<int> queued;
+	atomic<bool> running;
+	mutex sleepLock;
+	condition_variable wakeUp;
+};
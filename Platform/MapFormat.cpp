@@ -0,0 +1,84 @@
+#include "MapFormat.h"
+
+using namespace std;
+
+Uint32 adler32(const char *data, size_t size)
+{
+	Uint32 a = 1, b = 0;
+	while (size)
+	{
+		//5552 is the largest block that can't overflow before the modulo
+		size_t block = size < 5552 ? size : 5552;
+		size -= block;
+		while (block--)
+		{
+			a += (Uint8)*data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return (b << 16) | a;
+}
+
+void encodeTiles(vector<char> &out, const char *tiles, size_t count, bool compress)
+{
+	out.reserve(out.size() + count + 1);
+	if (compress)
+	{
+		out.push_back(MAP_RLE);
+		for (size_t i = 0; i < count;)
+		{
+			size_t run = 1;
+			while (run < 255 && i + run < count && tiles[i + run] == tiles[i]) run++;
+			out.push_back((char)run);
+			out.push_back(tiles[i]);
+			i += run;
+		}
+	}
+	else
+	{
+		out.push_back(MAP_RAW);
+		out.insert(out.end(), tiles, tiles + count);
+	}
+}
+
+bool decodeTiles(MapReader &reader, Uint8 encoding, size_t count, char *out)
+{
+	switch (encoding)
+	{
+	case MAP_RAW:
+	{
+		if ((size_t)(reader.end - reader.pos) < count) return false;
+		memcpy(out, reader.pos, count);
+		reader.pos += count;
+		return true;
+	}
+	case MAP_RLE:
+	{
+		size_t i = 0;
+		while (i < count)
+		{
+			Uint8 run;
+			char type;
+			if (!reader.read(run) || !reader.read(type) || run == 0 || run > count - i) return false;
+			memset(out + i, type, run);
+			i += run;
+		}
+		return true;
+	}
+	default: return false;
+	}
+}
+
+bool tilesFit(const MapReader &reader, Uint8 encoding, size_t count)
+{
+	size_t left = reader.end - reader.pos;
+	switch (encoding)
+	{
+	case MAP_RAW: return count <= left;
+	//every byte pair covers at most 255 tiles
+	case MAP_RLE: return (count + 254) / 255 <= left / 2;
+	default: return false;
+	}
+}
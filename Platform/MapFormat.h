@@ -0,0 +1,54 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <string>
+#include <vector>
+#include <cstring>
+
+using namespace std;
+
+//pieces shared by the .map file of Tilemap, the world file of TileStore and the input log
+
+enum MapEncoding : Uint8
+{
+	MAP_RAW = 0,
+	MAP_RLE = 1
+};
+
+Uint32 adler32(const char *data, size_t size);
+
+//bounds checked cursor over the file contents
+struct MapReader
+{
+	const char *pos;
+	const char *end;
+
+	template <typename T> bool read(T &value)
+	{
+		if (end - pos < (ptrdiff_t)sizeof(T)) return false;
+		memcpy(&value, pos, sizeof(T));
+		pos += sizeof(T);
+		return true;
+	}
+	bool readString(string &str)
+	{
+		const char *terminator = (const char *)memchr(pos, '\0', end - pos);
+		if (!terminator) return false;
+		str.assign(pos, terminator);
+		pos = terminator + 1;
+		return true;
+	}
+};
+
+template <typename T> inline void writeValue(vector<char> &out, const T &value)
+{
+	const char *bytes = (const char *)&value;
+	out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+//Uint8 encoding (MAP_RAW or MAP_RLE), then count tiles or (count, type) byte pairs
+void encodeTiles(vector<char> &out, const char *tiles, size_t count, bool compress);
+//the same without the encoding byte, which the caller has already read
+bool decodeTiles(MapReader &reader, Uint8 encoding, size_t count, char *out);
+//whether what is left in the reader can hold count tiles, checked before making room for them
+bool tilesFit(const MapReader &reader, Uint8 encoding, size_t count);
@@ -0,0 +1,211 @@
+#include "Profiler.h"
+#include <fstream>
+#include <unordered_map>
+
+using namespace std;
+
+thread_local int ProfileZone::depth = 0;
+
+//index of the calling thread in the trace, handed out on first use
+static thread_local int profileThread = -1;
+
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Profiler()
+{
+	enabled = false;
+	epoch = chrono::steady_clock::now();
+	events.resize(bufferSize);
+	head = 0;
+	threadCount = 0;
+
+	frame = 0;
+	frameStart = 0;
+	frameHead = 0;
+	frameThread = 0;
+	history.resize(historySize);
+	for (auto &i : history)
+	{
+		i.start = i.end = 0;
+		i.zoneCount = 0;
+	}
+	historyHead = 0;
+}
+
+void Profiler::setEnabled(bool _enabled)
+{
+	enabled = _enabled;
+}
+
+Uint16 Profiler::threadIndex()
+{
+	if (profileThread < 0) profileThread = threadCount++;
+	return (Uint16)profileThread;
+}
+
+void Profiler::record(const char *name, Uint64 start, Uint64 end, Uint8 depth)
+{
+	Uint64 slot = head.fetch_add(1, memory_order_relaxed);
+	ProfileEvent &e = events[slot % bufferSize];
+	e.name = name;
+	e.start = start;
+	e.end = end;
+	e.frame = frame.load(memory_order_relaxed);
+	e.thread = threadIndex();
+	e.depth = depth;
+}
+
+void Profiler::beginFrame()
+{
+	if (!isEnabled()) return;
+	frameThread = threadIndex();
+	frameStart = now();
+	frameHead = head.load(memory_order_relaxed);
+}
+
+void Profiler::endFrame()
+{
+	if (!isEnabled()) return;
+
+	ProfileFrame &record = history[historyHead];
+	historyHead = (historyHead + 1) % historySize;
+	record.start = frameStart;
+	record.end = now();
+	record.zoneCount = 0;
+
+	//sum up the top level zones of this frame, older events have been overwritten if the frame recorded more than fit
+	Uint64 last = head.load(memory_order_relaxed);
+	Uint64 first = last - frameHead > bufferSize ? last - bufferSize : frameHead;
+	for (Uint64 i = first; i < last; i++)
+	{
+		const ProfileEvent &e = events[i % bufferSize];
+		if (e.depth || e.thread != frameThread) continue;
+
+		int zone = 0;
+		while (zone < record.zoneCount && record.names[zone] != e.name) zone++;
+		if (zone == record.zoneCount)
+		{
+			if (zone == ProfileFrame::maxZones) continue;
+			record.names[zone] = e.name;
+			record.times[zone] = 0;
+			record.zoneCount++;
+		}
+		record.times[zone] += e.end - e.start;
+	}
+
+	frame.fetch_add(1, memory_order_relaxed);
+}
+
+void Profiler::renderOverlay(Window *window, const SDL_Rect &area) const
+{
+	static const SDL_Color palette[ProfileFrame::maxZones] = {
+		{ 230, 80, 80, 255 }, { 80, 200, 80, 255 }, { 80, 120, 230, 255 }, { 230, 200, 60, 255 },
+		{ 200, 80, 200, 255 }, { 60, 200, 200, 255 }, { 240, 140, 40, 255 }, { 160, 160, 240, 255 } };
+	const double scale = area.h / 33.3e6;	//the full height is two frames at 60 per second
+
+	//colors are handed out in the order zones first show up, so they stay put from frame to frame
+	vector<const char*> &names = zoneNames;
+	vector<SDL_Rect> bars[ProfileFrame::maxZones + 1];	//last one is time outside any zone
+
+	int columns = area.w < (int)historySize ? area.w : (int)historySize;
+	for (int i = 0; i < columns; i++)
+	{
+		const ProfileFrame &f = history[(historyHead + historySize - columns + i) % historySize];
+		if (f.end <= f.start) continue;
+
+		int x = area.x + i * area.w / columns;
+		int w = (i + 1) * area.w / columns - i * area.w / columns;
+		int bottom = area.y + area.h;
+		Uint64 zoned = 0;
+		for (int z = 0; z < f.zoneCount; z++)
+		{
+			unsigned color = 0;
+			while (color < names.size() && names[color] != f.names[z]) color++;
+			if (color == names.size()) names.push_back(f.names[z]);
+			color %= ProfileFrame::maxZones;
+
+			int h = int(f.times[z] * scale);
+			bars[color].push_back(SDL_Rect{ x, bottom - h, w, h });
+			bottom -= h;
+			zoned += f.times[z];
+		}
+		Uint64 rest = f.end - f.start > zoned ? f.end - f.start - zoned : 0;
+		int h = int(rest * scale);
+		bars[ProfileFrame::maxZones].push_back(SDL_Rect{ x, bottom - h, w, h });
+	}
+
+	//one call per color
+	SDL_SetRenderDrawColor(window->ren, 0, 0, 0, 255);
+	SDL_RenderFillRect(window->ren, &area);
+	for (int i = 0; i <= ProfileFrame::maxZones; i++)
+	{
+		if (bars[i].empty()) continue;
+		if (i < ProfileFrame::maxZones) SDL_SetRenderDrawColor(window->ren, palette[i].r, palette[i].g, palette[i].b, 255);
+		else SDL_SetRenderDrawColor(window->ren, 96, 96, 96, 255);
+		SDL_RenderFillRects(window->ren, bars[i].data(), bars[i].size());
+	}
+
+	int budget = area.y + area.h - int(16.67e6 * scale);
+	SDL_SetRenderDrawColor(window->ren, 255, 255, 255, 255);
+	SDL_RenderDrawLine(window->ren, area.x, budget, area.x + area.w - 1, budget);
+}
+
+void Profiler::collect(vector<ProfileEvent> &out) const
+{
+	Uint64 last = head.load(memory_order_relaxed);
+	Uint64 first = last > bufferSize ? last - bufferSize : 0;
+	out.clear();
+	out.reserve((size_t)(last - first));
+	for (Uint64 i = first; i < last; i++) out.push_back(events[i % bufferSize]);
+}
+
+bool Profiler::exportTrace(const string &file) const
+{
+	vector<ProfileEvent> list;
+	collect(list);
+
+	ofstream out(file.c_str());
+	out << "{\"traceEvents\":[" << endl;
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		const ProfileEvent &e = list[i];
+		out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << e.thread
+			<< ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << (e.end - e.start) / 1000.0
+			<< ",\"args\":{\"frame\":" << e.frame << "}}" << (i + 1 < list.size() ? "," : "") << endl;
+	}
+	out << "]}" << endl;
+	out.close();
+
+	if (!out)
+	{
+		cout << "Saving " << file.c_str() << " failed" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool Profiler::exportCSV(const string &file) const
+{
+	vector<ProfileEvent> list;
+	collect(list);
+
+	ofstream out(file.c_str());
+	out << "name,frame,thread,depth,start_us,duration_us" << endl;
+	for (auto &e : list)
+	{
+		out << e.name << "," << e.frame << "," << e.thread << "," << (int)e.depth << ","
+			<< e.start / 1000.0 << "," << (e.end - e.start) / 1000.0 << endl;
+	}
+	out.close();
+
+	if (!out)
+	{
+		cout << "Saving " << file.c_str() << " failed" << endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "Window.h"
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+//one timed zone as it was recorded
+struct ProfileEvent
+{
+	const char *name;	//has to be a string literal or otherwise outlive the profiler
+	Uint64 start;		//nanoseconds since the profiler was created
+	Uint64 end;
+	Uint32 frame;
+	Uint16 thread;		//small index, 0 for the first thread that recorded anything
+	Uint8 depth;		//how many zones the thread was already in
+};
+
+//frame time and where the top level zones of the frame thread spent it, for the overlay
+struct ProfileFrame
+{
+	static const int maxZones = 8;
+	Uint64 start;
+	Uint64 end;
+	int zoneCount;
+	const char *names[maxZones];
+	Uint64 times[maxZones];
+};
+
+//records zones from any thread into a fixed ring buffer, claiming a slot is a single atomic increment
+//while disabled a zone costs one relaxed load, defining PLATFORM_NO_PROFILER removes them altogether
+//the buffer is read between frames, events written while it is read may come out torn
+class Profiler
+{
+public:
+	static Profiler& get();
+
+	void setEnabled(bool _enabled);
+	inline bool isEnabled() const { return enabled.load(memory_order_relaxed); }
+
+	inline Uint64 now() const { return (Uint64)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count(); }
+	void record(const char *name, Uint64 start, Uint64 end, Uint8 depth);
+
+	//frame boundaries, called from the thread that runs the game loop
+	void beginFrame();
+	void endFrame();
+
+	//frame time graph with each top level zone in its own color, a line marks 60 frames per second
+	void renderOverlay(Window *window, const SDL_Rect &area) const;
+
+	//whatever is still in the ring buffer
+	bool exportTrace(const string &file) const;		//Chrome trace event JSON, opens in chrome://tracing or Perfetto
+	bool exportCSV(const string &file) const;
+	void collect(vector<ProfileEvent> &out) const;	//oldest first
+
+	static const unsigned bufferSize = 1 << 16;		//power of two
+	static const unsigned historySize = 240;
+
+private:
+	Profiler();
+	Uint16 threadIndex();
+
+	atomic<bool> enabled;
+	chrono::steady_clock::time_point epoch;
+	vector<ProfileEvent> events;
+	atomic<Uint64> head;		//total events ever recorded, the next slot is head % bufferSize
+	atomic<Uint16> threadCount;
+
+	atomic<Uint32> frame;		//stamped on events by every thread, only endFrame moves it on
+	Uint64 frameStart;
+	Uint64 frameHead;			//head when the frame began
+	Uint16 frameThread;
+	vector<ProfileFrame> history;
+	unsigned historyHead;
+	mutable vector<const char*> zoneNames;	//order top level zones were first seen in, picks their color
+};
+
+//times the enclosing scope, or until end is called
+class ProfileZone
+{
+public:
+	inline ProfileZone(const char *_name)
+	{
+		name = Profiler::get().isEnabled() ? _name : nullptr;
+		if (!name) return;
+		depth++;
+		start = Profiler::get().now();
+	}
+	inline ~ProfileZone() { end(); }
+	inline void end()
+	{
+		if (!name) return;
+		depth--;
+		Profiler::get().record(name, start, Profiler::get().now(), (Uint8)depth);
+		name = nullptr;
+	}
+
+private:
+	const char *name;
+	Uint64 start;
+	static thread_local int depth;
+};
+
+#ifdef PLATFORM_NO_PROFILER
+#define PROFILE_ZONE(name)
+#else
+#define PROFILE_JOIN(a, b) a##b
+#define PROFILE_NAME(line) PROFILE_JOIN(profileZone, line)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_NAME(__LINE__)(name)
+#endif
@@ -0,0 +1,105 @@
+#include "SheetLoader.h"
+#include "JobSystem.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+SheetLoader::SheetLoader(JobSystem *_jobs, Window *_window)
+{
+	jobs = _jobs;
+	window = _window;
+	counter.reset(new JobCounter);
+	requestCount = 0;
+	loadCount = 0;
+	decodeCount = 0;
+}
+
+SheetLoader::~SheetLoader()
+{
+	if (jobs) jobs->wait(*counter);
+}
+
+void SheetLoader::request(Spritesheet *sheet, const string &file, int tileRes, Callback done)
+{
+	unique_ptr<Request> r(new Request);
+	r->sheet = sheet;
+	r->done = move(done);
+	r->pixels.file = file;
+	r->pixels.tileRes = tileRes;
+	requestCount++;
+
+	if (!jobs)
+	{
+		waiting.push_back(move(r));
+		return;
+	}
+
+	Request *pending = r.get();
+	{
+		lock_guard<mutex> guard(lock);
+		running.push_back(move(r));
+	}
+	jobs->submit([this, pending]() { decode(pending); }, *counter);
+}
+
+void SheetLoader::decode(Request *request)
+{
+	request->sheet->decodeSheet(request->pixels.file, request->pixels.tileRes, request->pixels);
+	decodeCount++;
+
+	lock_guard<mutex> guard(lock);
+	auto it = find_if(running.begin(), running.end(), [request](const unique_ptr<Request> &i) { return i.get() == request; });
+	decoded.push_back(move(*it));
+	running.erase(it);
+}
+
+unsigned SheetLoader::poll(unsigned maxSheets)
+{
+	//nobody else to decode, do one per poll so the loading screen still gets drawn in between
+	if (!jobs && !waiting.empty() && decoded.size() < maxSheets)
+	{
+		unique_ptr<Request> r = move(waiting.front());
+		waiting.erase(waiting.begin());
+		Request *pending = r.get();
+		running.push_back(move(r));
+		decode(pending);
+	}
+
+	vector<unique_ptr<Request>> ready;
+	{
+		lock_guard<mutex> guard(lock);
+		unsigned count = min((unsigned)decoded.size(), maxSheets);
+		for (unsigned i = 0; i < count; i++) ready.push_back(move(decoded[i]));
+		decoded.erase(decoded.begin(), decoded.begin() + count);
+	}
+
+	//textures can only be created on the main thread
+	for (auto &r : ready)
+	{
+		bool ok = r->pixels.ok;
+		string file = r->pixels.file;
+		r->sheet->uploadSheet(r->pixels, window);
+		loadCount++;
+
+		if (ok) cout << "Loaded " << file.c_str() << endl;
+		else cout << "Loading " << file.c_str() << " failed" << endl;
+		if (r->done) r->done(r->sheet, ok);
+	}
+
+	return ready.size();
+}
+
+void SheetLoader::finish()
+{
+	while (!done())
+	{
+		if (!poll(requestCount)) this_thread::yield();
+	}
+}
+
+float SheetLoader::progress() const
+{
+	if (!requestCount) return 1.0f;
+	return (decodeCount + loadCount) / (2.0f * requestCount);
+}
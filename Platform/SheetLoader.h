@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Spritesheet.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+class JobSystem;
+struct JobCounter;
+
+//loads sprite sheets in the background: decoding and slicing run as jobs on the job system,
+//the main thread uploads finished sheets in poll so it can keep drawing a loading screen meanwhile
+//with several sheets the wait is as long as the slowest decode instead of all of them together
+class SheetLoader
+{
+public:
+	typedef function<void(Spritesheet *sheet, bool ok)> Callback;
+
+	SheetLoader(JobSystem *_jobs, Window *_window);	//without a job system sheets decode on the main thread in poll
+	~SheetLoader();	//waits for decodes still running
+
+	//sheet has to stay alive until its callback ran, it's empty until then
+	void request(Spritesheet *sheet, const string &file, int tileRes, Callback done = nullptr);
+	//main thread only, uploads at most maxSheets decoded sheets and runs their callbacks, returns how many
+	unsigned poll(unsigned maxSheets = 1);
+	void finish();		//poll until everything requested is loaded
+
+	inline unsigned requested() const { return requestCount; }
+	inline unsigned loaded() const { return loadCount; }
+	inline bool done() const { return loadCount == requestCount; }
+	float progress() const;		//0 to 1, counts decoded sheets as half done
+
+private:
+	struct Request
+	{
+		Spritesheet *sheet;
+		Callback done;
+		SheetPixels pixels;
+	};
+
+	void decode(Request *request);
+
+	JobSystem *jobs;
+	Window *window;
+	unique_ptr<JobCounter> counter;
+
+	mutex lock;
+	vector<unique_ptr<Request>> waiting;	//not decoded yet, only used without a job system
+	vector<unique_ptr<Request>> decoded;	//ready for upload, in the order they finished
+	vector<unique_ptr<Request>> running;	//handed to the job system, owned here until decoded
+
+	unsigned requestCount;
+	unsigned loadCount;
+	atomic<unsigned> decodeCount;
+};
@@ -0,0 +1,179 @@
+#include "SpatialHash.h"
+#include "Entity.h"
+#include <algorithm>
+
+using namespace std;
+
+SpatialHash::SpatialHash(int _tileRes, int _cellTiles)
+{
+	tileRes = _tileRes;
+	cellTiles = _cellTiles;
+	count = 0;
+}
+
+SpatialHash::~SpatialHash()
+{
+	clear();
+}
+
+void SpatialHash::insert(Entity *entity)
+{
+	entity->updateTile();
+	add(entity, cellOf(entity->tileX), cellOf(entity->tileY));
+	entity->grid = this;
+}
+
+void SpatialHash::remove(Entity *entity)
+{
+	erase(entity, cellOf(entity->tileX), cellOf(entity->tileY));
+	entity->grid = nullptr;
+}
+
+void SpatialHash::move(Entity *entity, int oldTileX, int oldTileY)
+{
+	int oldX = cellOf(oldTileX);
+	int oldY = cellOf(oldTileY);
+	int newX = cellOf(entity->tileX);
+	int newY = cellOf(entity->tileY);
+
+	//most tile changes stay inside the same bucket
+	if (oldX == newX && oldY == newY) return;
+
+	erase(entity, oldX, oldY);
+	add(entity, newX, newY);
+}
+
+void SpatialHash::clear()
+{
+	for (auto &i : cells)
+	{
+		for (auto &j : i.second) j->grid = nullptr;
+	}
+	cells.clear();
+	count = 0;
+}
+
+void SpatialHash::queryRadius(int x, int y, int radius, vector<Entity*> &out) const
+{
+	int firstX = cellOf(tileOf(x - radius));
+	int firstY = cellOf(tileOf(y - radius));
+	int lastX = cellOf(tileOf(x + radius));
+	int lastY = cellOf(tileOf(y + radius));
+
+	Sint64 limit = Sint64(radius)*radius;
+	for (int cy = firstY; cy <= lastY; cy++)
+	{
+		for (int cx = firstX; cx <= lastX; cx++)
+		{
+			auto it = cells.find(key(cx, cy));
+			if (it == cells.end()) continue;
+
+			for (auto &i : it->second)
+			{
+				Sint64 dx = i->x - x;
+				Sint64 dy = i->y - y;
+				if (dx*dx + dy*dy <= limit) out.push_back(i);
+			}
+		}
+	}
+}
+
+void SpatialHash::queryRect(const SDL_Rect &area, vector<Entity*> &out) const
+{
+	//an entity's box reaches one tile past its position, so look one tile further up and left
+	int firstX = cellOf(tileOf(area.x - tileRes));
+	int firstY = cellOf(tileOf(area.y - tileRes));
+	int lastX = cellOf(tileOf(area.x + area.w));
+	int lastY = cellOf(tileOf(area.y + area.h));
+
+	for (int cy = firstY; cy <= lastY; cy++)
+	{
+		for (int cx = firstX; cx <= lastX; cx++)
+		{
+			auto it = cells.find(key(cx, cy));
+			if (it == cells.end()) continue;
+
+			for (auto &i : it->second)
+			{
+				if (i->x < area.x + area.w && i->x + tileRes > area.x && i->y < area.y + area.h && i->y + tileRes > area.y) out.push_back(i);
+			}
+		}
+	}
+}
+
+void SpatialHash::queryNearest(int x, int y, unsigned k, vector<Entity*> &out) const
+{
+	if (k == 0 || count == 0) return;
+
+	int cellPixels = cellTiles*tileRes;
+	int centerX = cellOf(tileOf(x));
+	int centerY = cellOf(tileOf(y));
+
+	//max heap on squared distance holding the best k so far
+	vector<pair<Sint64, Entity*>> best;
+	unsigned seen = 0;
+
+	//search square rings of buckets outwards, ring r can't hold anything closer than (r - 1) buckets
+	for (int r = 0; seen < count; r++)
+	{
+		if (best.size() == k && r > 0)
+		{
+			Sint64 bound = Sint64(r - 1)*cellPixels;
+			if (bound*bound > best.front().first) break;
+		}
+
+		for (int cy = centerY - r; cy <= centerY + r; cy++)
+		{
+			//only the border of the square is new
+			int step = (cy == centerY - r || cy == centerY + r) ? 1 : 2*r;
+			for (int cx = centerX - r; cx <= centerX + r; cx += step)
+			{
+				auto it = cells.find(key(cx, cy));
+				if (it == cells.end()) continue;
+
+				for (auto &i : it->second)
+				{
+					seen++;
+					Sint64 dx = i->x - x;
+					Sint64 dy = i->y - y;
+					Sint64 d = dx*dx + dy*dy;
+					if (best.size() < k)
+					{
+						best.push_back(make_pair(d, i));
+						push_heap(best.begin(), best.end());
+					}
+					else if (d < best.front().first)
+					{
+						pop_heap(best.begin(), best.end());
+						best.back() = make_pair(d, i);
+						push_heap(best.begin(), best.end());
+					}
+				}
+			}
+		}
+	}
+
+	sort_heap(best.begin(), best.end());
+	for (auto &i : best) out.push_back(i.second);
+}
+
+void SpatialHash::add(Entity *entity, int cx, int cy)
+{
+	cells[key(cx, cy)].push_back(entity);
+	count++;
+}
+
+void SpatialHash::erase(Entity *entity, int cx, int cy)
+{
+	auto it = cells.find(key(cx, cy));
+	if (it == cells.end()) return;
+
+	vector<Entity*> &bucket = it->second;
+	auto found = find(bucket.begin(), bucket.end(), entity);
+	if (found == bucket.end()) return;
+
+	*found = bucket.back();
+	bucket.pop_back();
+	if (bucket.empty()) cells.erase(it);
+	count--;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include <SDL2/SDL.h>
+
+using namespace std;
+
+class Entity;
+
+//rounds down for negative pixels too, so tiles and buckets just left of or above 0 don't merge with the ones right of it
+inline int floorDiv(int a, int b) { return a >= 0 ? a / b : -((-a + b - 1) / b); }
+
+//entities bucketed by the tile they're on (tileX/tileY from Entity::updateTile), a bucket covers cellTiles*cellTiles tiles
+//entities that are registered move between buckets by themselves from updateTile
+//distances are compared squared, positions are the entities' x and y in pixels
+class SpatialHash
+{
+public:
+	SpatialHash(int _tileRes, int _cellTiles = 4);
+	~SpatialHash();	//entities still in it are let go, so they don't unregister from a dead hash later
+
+	void insert(Entity *entity);
+	void remove(Entity *entity);
+	void move(Entity *entity, int oldTileX, int oldTileY);	//entity's tile changed from old to current
+	void clear();
+
+	void queryRadius(int x, int y, int radius, vector<Entity*> &out) const;	//entities within radius of x,y
+	void queryRect(const SDL_Rect &area, vector<Entity*> &out) const;		//entities whose tile sized box overlaps area
+	void queryNearest(int x, int y, unsigned k, vector<Entity*> &out) const;	//up to k closest, closest first
+
+	int tileRes;
+	int cellTiles;
+	unsigned count;
+	unordered_map<Sint64, vector<Entity*>> cells;
+
+private:
+	inline int tileOf(int pixel) const { return floorDiv(pixel, tileRes); }
+	inline int cellOf(int tile) const { return floorDiv(tile, cellTiles); }
+	inline Sint64 key(int cx, int cy) const { return Sint64((Uint64(Uint32(cy)) << 32) | Uint32(cx)); }	//shifted unsigned, cy can be negative
+	void add(Entity *entity, int cx, int cy);
+	void erase(Entity *entity, int cx, int cy);
+};
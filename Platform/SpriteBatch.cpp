@@ -0,0 +1,78 @@
+#include "SpriteBatch.h"
+
+using namespace std;
+
+SpriteBatch::SpriteBatch()
+{
+	texture = nullptr;
+	texWidth = 0;
+	texHeight = 0;
+	quads = 0;
+}
+
+void SpriteBatch::begin(SDL_Texture *_texture)
+{
+	if (_texture != texture)
+	{
+		texture = _texture;
+		texWidth = texHeight = 0;
+		if (texture) SDL_QueryTexture(texture, NULL, NULL, &texWidth, &texHeight);
+	}
+	quads = 0;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	vertices.clear();
+#else
+	sources.clear();
+	destinations.clear();
+#endif
+}
+
+void SpriteBatch::add(const SDL_Rect *src, const SDL_Rect &dst)
+{
+	SDL_Rect full = { 0, 0, texWidth, texHeight };
+	if (!src) src = &full;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	float u1 = float(src->x) / texWidth;
+	float v1 = float(src->y) / texHeight;
+	float u2 = float(src->x + src->w) / texWidth;
+	float v2 = float(src->y + src->h) / texHeight;
+	float x1 = float(dst.x);
+	float y1 = float(dst.y);
+	float x2 = float(dst.x + dst.w);
+	float y2 = float(dst.y + dst.h);
+	SDL_Color white = { 255, 255, 255, 255 };
+
+	vertices.push_back(SDL_Vertex{ { x1, y1 }, white, { u1, v1 } });
+	vertices.push_back(SDL_Vertex{ { x2, y1 }, white, { u2, v1 } });
+	vertices.push_back(SDL_Vertex{ { x2, y2 }, white, { u2, v2 } });
+	vertices.push_back(SDL_Vertex{ { x1, y2 }, white, { u1, v2 } });
+
+	if (indices.size() < (quads + 1) * 6)
+	{
+		int first = quads * 4;
+		int pattern[6] = { first, first + 1, first + 2, first, first + 2, first + 3 };
+		indices.insert(indices.end(), pattern, pattern + 6);
+	}
+#else
+	sources.push_back(*src);
+	destinations.push_back(dst);
+#endif
+
+	quads++;
+}
+
+void SpriteBatch::submit(SDL_Renderer *ren) const
+{
+	if (!quads) return;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	SDL_RenderGeometry(ren, texture, vertices.data(), vertices.size(), indices.data(), quads * 6);
+#else
+	for (unsigned i = 0; i < quads; i++)
+	{
+		SDL_RenderCopy(ren, texture, &sources[i], &destinations[i]);
+	}
+#endif
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <vector>
+
+using namespace std;
+
+//textured quads from one texture, collected and then drawn with a single SDL_RenderGeometry call
+//on SDL versions without SDL_RenderGeometry it falls back to one SDL_RenderCopy per quad
+class SpriteBatch
+{
+public:
+	SpriteBatch();
+
+	void begin(SDL_Texture *_texture);		//drop everything, following quads come from _texture
+	void add(const SDL_Rect *src, const SDL_Rect &dst);	//src NULL for the whole texture
+	void submit(SDL_Renderer *ren) const;
+	inline unsigned size() const { return quads; }
+
+	SDL_Texture *texture;
+	int texWidth;
+	int texHeight;
+	unsigned quads;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	vector<SDL_Vertex> vertices;	//4 per quad
+	vector<int> indices;			//6 per quad, the pattern never changes so it's only ever grown
+#else
+	vector<SDL_Rect> sources;
+	vector<SDL_Rect> destinations;
+#endif
+};
@@ -1,73 +1,277 @@
 #include "Spritesheet.h"
+#include <cstring>
 
 using namespace std;
 
-Spritesheet::Spritesheet(const string &_file, int _tileRes, Window *window)
+Spritesheet::Spritesheet(const string &_file, int _tileRes, Window *window, bool _useAtlas, bool _rotations)
 {
+	atlas = nullptr;
+	for (auto &i : turnedAtlas) i = nullptr;
+	textureBytes = 0;
+	tileRes = _tileRes;
+	useAtlas = _useAtlas;
+	rotations = _rotations;
 	makeSheet(_file, _tileRes, window);
 }
 
+Spritesheet::Spritesheet(bool _useAtlas, bool _rotations)
+{
+	atlas = nullptr;
+	for (auto &i : turnedAtlas) i = nullptr;
+	textureBytes = 0;
+	tileRes = 0;
+	useAtlas = _useAtlas;
+	rotations = _rotations;
+}
+
 Spritesheet::~Spritesheet()
+{
+	destroyTextures();
+}
+
+void Spritesheet::destroyTextures()
 {
 	for (auto &i : frames)
 	{
 		SDL_DestroyTexture(i);
 	}
 	frames.clear();
+	if (atlas)
+	{
+		SDL_DestroyTexture(atlas);
+		atlas = nullptr;
+	}
+	textureBytes = 0;
+
+	for (int t = 0; t < 3; t++)
+	{
+		for (auto &i : turnedFrames[t])
+		{
+			SDL_DestroyTexture(i);
+		}
+		turnedFrames[t].clear();
+		if (turnedAtlas[t])
+		{
+			SDL_DestroyTexture(turnedAtlas[t]);
+			turnedAtlas[t] = nullptr;
+		}
+	}
 }
 
 void Spritesheet::makeSheet(const string &_file, int _tileRes, Window *window)
 {
-	tileRes = _tileRes;
-	frames.clear();
-
 	cout << "Loading " << _file.c_str() << "... ";
 
-	SDL_Surface *fullSurf = IMG_Load(_file.c_str());
-	if (!fullSurf)
-	{
-		cout << "Loading failed" << endl;
-		return;
-	}
+	SheetPixels pixels;
+	decodeSheet(_file, _tileRes, pixels);
+	uploadSheet(pixels, window);
+
+	if (pixels.ok) cout << "Ok" << endl;
+	else cout << "Loading failed" << endl;
+}
 
+void Spritesheet::decodeSheet(const string &_file, int _tileRes, SheetPixels &pixels) const
+{
+	pixels.file = _file;
+	pixels.tileRes = _tileRes;
 
-	SDL_Rect fullRect;
-	fullRect.x = fullRect.y = 0;
-	fullRect.w = fullSurf->w;
-	fullRect.h = fullSurf->h;
+	SDL_Surface *fullSurf = IMG_Load(_file.c_str());
+	if (!fullSurf) return;
 
-	SDL_Texture *tex;
-	SDL_Surface *surf = SDL_CreateRGBSurface(0, tileRes, tileRes, 24, 0, 0, 0, 0);
 	SDL_Rect recto;
-	recto.w = recto.h = tileRes;
-	recto.x = recto.y = 0;
+	recto.w = recto.h = _tileRes;
 
-	//chop into tiles
-	for (recto.y = 0; recto.y < fullRect.h; recto.y += tileRes)
+	//record where each tile is in the sheet
+	for (recto.y = 0; recto.y < fullSurf->h; recto.y += _tileRes)
 	{
-		for (recto.x = 0; recto.x < fullRect.w; recto.x += tileRes)
+		for (recto.x = 0; recto.x < fullSurf->w; recto.x += _tileRes)
 		{
-			SDL_BlitSurface(fullSurf, &recto, surf, NULL);
-			tex = SDL_CreateTextureFromSurface(window->ren, surf);
-			frames.push_back(tex);
+			pixels.clips.push_back(recto);
 		}
 	}
 
+	if (!useAtlas)
+	{
+		//chop into tiles
+		for (auto &i : pixels.clips)
+		{
+			SDL_Surface *surf = SDL_CreateRGBSurface(0, _tileRes, _tileRes, 24, 0, 0, 0, 0);
+			SDL_BlitSurface(fullSurf, &i, surf, NULL);
+			pixels.frames.push_back(surf);
+		}
+	}
+
+	if (rotations)
+	{
+		//32 bit copy padded to whole tiles, so partial frames at the edges can be rotated like the rest
+		int paddedW = (fullSurf->w + _tileRes - 1) / _tileRes * _tileRes;
+		int paddedH = (fullSurf->h + _tileRes - 1) / _tileRes * _tileRes;
+		SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, paddedW, paddedH, 32, SDL_PIXELFORMAT_ARGB8888);
+		SDL_SetSurfaceBlendMode(fullSurf, SDL_BLENDMODE_NONE);
+		SDL_BlitSurface(fullSurf, NULL, sheet, NULL);
+
+		for (int t = 0; t < 3; t++)
+		{
+			SDL_Surface *target = SDL_CreateRGBSurfaceWithFormat(0, paddedW, paddedH, 32, SDL_PIXELFORMAT_ARGB8888);
+			SDL_LockSurface(sheet);
+			SDL_LockSurface(target);
+			for (auto &i : pixels.clips)
+			{
+				rotateFrameCW(sheet, i, target, t + 1);
+			}
+			SDL_UnlockSurface(target);
+			SDL_UnlockSurface(sheet);
+
+			if (useAtlas)
+			{
+				pixels.turned[t] = target;
+			}
+			else
+			{
+				for (auto &i : pixels.clips)
+				{
+					SDL_Surface *surf = SDL_CreateRGBSurface(0, _tileRes, _tileRes, 24, 0, 0, 0, 0);
+					SDL_BlitSurface(target, &i, surf, NULL);
+					pixels.turnedFrames[t].push_back(surf);
+				}
+				SDL_FreeSurface(target);
+			}
+		}
+
+		SDL_FreeSurface(sheet);
+	}
 
-	SDL_FreeSurface(surf);
-	SDL_FreeSurface(fullSurf);
+	//one texture for the whole sheet, tiles are drawn through clips
+	if (useAtlas) pixels.full = fullSurf;
+	else SDL_FreeSurface(fullSurf);
 
-	cout << "Ok" << endl;
+	pixels.ok = true;
 }
 
-SDL_Texture* Spritesheet::rotateFrameCW(unsigned index, Window *window)
+void Spritesheet::uploadSheet(SheetPixels &pixels, Window *window)
 {
-	SDL_Surface* target = SDL_CreateRGBSurface(0, tileRes, tileRes, 32, 0xff000000, 0x00ff0000, 0x0000ff00, 0x000000ff);
+	tileRes = pixels.tileRes;
+	destroyTextures();
+	clips = pixels.clips;
 
-	Uint8 *srcPixels;
+	if (pixels.ok)
+	{
+		if (pixels.full)
+		{
+			atlas = SDL_CreateTextureFromSurface(window->ren, pixels.full);
+			textureBytes += pixels.full->w * pixels.full->h * 4;
+		}
+		for (auto &i : pixels.frames)
+		{
+			frames.push_back(SDL_CreateTextureFromSurface(window->ren, i));
+			textureBytes += i->w * i->h * 4;
+		}
+
+		for (int t = 0; t < 3; t++)
+		{
+			if (pixels.turned[t])
+			{
+				turnedAtlas[t] = SDL_CreateTextureFromSurface(window->ren, pixels.turned[t]);
+				textureBytes += pixels.turned[t]->w * pixels.turned[t]->h * 4;
+			}
+			for (auto &i : pixels.turnedFrames[t])
+			{
+				turnedFrames[t].push_back(SDL_CreateTextureFromSurface(window->ren, i));
+				textureBytes += i->w * i->h * 4;
+			}
+		}
+	}
+
+	pixels.clear();
+}
+
+void SheetPixels::clear()
+{
+	if (full)
+	{
+		SDL_FreeSurface(full);
+		full = nullptr;
+	}
+	for (auto &i : frames)
+	{
+		SDL_FreeSurface(i);
+	}
+	frames.clear();
 
+	for (int t = 0; t < 3; t++)
+	{
+		if (turned[t])
+		{
+			SDL_FreeSurface(turned[t]);
+			turned[t] = nullptr;
+		}
+		for (auto &i : turnedFrames[t])
+		{
+			SDL_FreeSurface(i);
+		}
+		turnedFrames[t].clear();
+	}
+}
 
-	SDL_Texture* source = frames[index];
+void Spritesheet::rotateFrameCW(SDL_Surface *sheet, const SDL_Rect &clip, SDL_Surface *target, int turns) const
+{
+	//both surfaces 32 bit, locked and large enough to hold clip, frames are square
+	const int block = 8;	//quarter turns walk the source by columns, blocks keep that within a few cache lines
+	int n = clip.w;
+	int srcPitch = sheet->pitch / 4;
+	int dstPitch = target->pitch / 4;
+	const Uint32 *src = (const Uint32*)sheet->pixels + clip.y*srcPitch + clip.x;
+	Uint32 *dst = (Uint32*)target->pixels + clip.y*dstPitch + clip.x;
 
-	return nullptr;
-}
\ No newline at end of file
+	switch (turns & 3)
+	{
+	case 0:
+		for (int y = 0; y < n; y++)
+		{
+			memcpy(dst + y*dstPitch, src + y*srcPitch, n * 4);
+		}
+		break;
+	case 1:
+		for (int by = 0; by < n; by += block)
+		{
+			for (int bx = 0; bx < n; bx += block)
+			{
+				for (int y = by; y < by + block && y < n; y++)
+				{
+					for (int x = bx; x < bx + block && x < n; x++)
+					{
+						dst[y*dstPitch + x] = src[(n - 1 - x)*srcPitch + y];
+					}
+				}
+			}
+		}
+		break;
+	case 2:
+		//rows reversed, straight runs the compiler can vectorize
+		for (int y = 0; y < n; y++)
+		{
+			const Uint32 *s = src + (n - 1 - y)*srcPitch + n - 1;
+			Uint32 *d = dst + y*dstPitch;
+			for (int x = 0; x < n; x++)
+			{
+				d[x] = s[-x];
+			}
+		}
+		break;
+	case 3:
+		for (int by = 0; by < n; by += block)
+		{
+			for (int bx = 0; bx < n; bx += block)
+			{
+				for (int y = by; y < by + block && y < n; y++)
+				{
+					for (int x = bx; x < bx + block && x < n; x++)
+					{
+						dst[y*dstPitch + x] = src[x*srcPitch + n - 1 - y];
+					}
+				}
+			}
+		}
+		break;
+	}
+}
@@ -5,16 +5,67 @@
 #include <vector>
 #include "Window.h"
 
+//pixels of a sheet decoded by Spritesheet::decodeSheet, waiting to be turned into textures
+//decoding doesn't touch the renderer so it can run on any thread, uploading has to happen on the main thread
+struct SheetPixels
+{
+	SheetPixels() : tileRes(0), ok(false), full(nullptr) { for (auto &i : turned) i = nullptr; }
+	~SheetPixels() { clear(); }
+	SheetPixels(const SheetPixels&) = delete;
+	SheetPixels& operator=(const SheetPixels&) = delete;
+	void clear();	//free the surfaces
+
+	string file;
+	int tileRes;
+	bool ok;
+	vector<SDL_Rect> clips;
+	SDL_Surface *full;						//whole sheet, atlas mode
+	vector<SDL_Surface*> frames;			//one per clip, otherwise
+	SDL_Surface *turned[3];					//rotations, same split
+	vector<SDL_Surface*> turnedFrames[3];
+};
+
 //this contains the textures of all the possible tiles
+//in atlas mode the whole sheet is a single texture and frames are addressed through clips
 class Spritesheet
 {
 public:
-	Spritesheet(const string &_file, int _tileRes, Window *window);
+	//with _rotations the frames are also rotated by 90, 180 and 270 degrees at load, see getTexture
+	Spritesheet(const string &_file, int _tileRes, Window *window, bool _useAtlas = true, bool _rotations = false);
+	Spritesheet(bool _useAtlas = true, bool _rotations = false);	//empty, to be filled by makeSheet or a SheetLoader
 	~Spritesheet();
 	void makeSheet(const string &_file, int _tileRes, Window *window);	//load image and chop it into tiles of requested size
-	SDL_Texture* rotateFrameCW(unsigned index, Window *window);
+	//makeSheet in two halves, decoding is thread safe and only reads useAtlas and rotations
+	void decodeSheet(const string &_file, int _tileRes, SheetPixels &pixels) const;
+	void uploadSheet(SheetPixels &pixels, Window *window);	//create textures, frees pixels
+	void rotateFrameCW(SDL_Surface *sheet, const SDL_Rect &clip, SDL_Surface *target, int turns) const;	//copy a frame turned clockwise by turns*90 degrees to the same place in target
 
-	vector<SDL_Texture*> frames;	//individual tiles/frames
+	//source texture and rect to use when drawing a frame, valid in both modes
+	inline SDL_Texture* getTexture(unsigned index) const { return useAtlas ? atlas : frames[index]; }
+	inline const SDL_Rect* getClip(unsigned index) const { return useAtlas ? &clips[index] : NULL; }
+	inline unsigned size() const { return clips.size(); }
+
+	//same for a frame turned clockwise by turns*90 degrees, the clip doesn't change since frames are rotated in place
+	//only valid if the sheet was loaded with rotations
+	inline SDL_Texture* getTexture(unsigned index, int turns) const
+	{
+		turns &= 3;
+		if (!turns) return getTexture(index);
+		return useAtlas ? turnedAtlas[turns - 1] : turnedFrames[turns - 1][index];
+	}
+
+	vector<SDL_Texture*> frames;	//individual tiles/frames, empty in atlas mode
+	vector<SDL_Rect> clips;			//position of each frame in the sheet, indexed like frames
+	SDL_Texture* atlas;				//the whole sheet, only used in atlas mode
 	int tileRes;
-};
+	bool useAtlas;
+	size_t textureBytes;			//estimated video memory of all textures, 4 bytes per pixel
 
+	//pre-rotated copies, 90, 180 and 270 degrees clockwise
+	bool rotations;
+	vector<SDL_Texture*> turnedFrames[3];
+	SDL_Texture* turnedAtlas[3];
+
+private:
+	void destroyTextures();
+};
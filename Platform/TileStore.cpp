@@ -0,0 +1,345 @@
+#include "TileStore.h"
+#include "JobSystem.h"
+#include "MapFormat.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+//world file layout, version 1
+//	magic "PWLD", Uint16 version, Uint8 chunk bits, char tileRes, int vertiTiles, int horiTiles, bitMapName + '\0'
+//	Uint32 adler-32 of the index, then the index: for every chunk in rows Uint64 offset, Uint32 size, Uint32 adler-32, char type
+//	size 0 means every tile of the chunk is type and nothing else is stored,
+//	otherwise size bytes at offset hold the tiles, encoded like the "TILE" section of a .map
+static const char worldMagic[4] = { 'P', 'W', 'L', 'D' };
+static const Uint16 worldVersion = 1;
+static const size_t indexEntrySize = sizeof(Uint64) + 2 * sizeof(Uint32) + sizeof(char);
+static const size_t chunkTiles = TileStore::CHUNK_SIZE*TileStore::CHUNK_SIZE;
+
+TileStore::TileStore(JobSystem *_jobs)
+{
+	jobs = _jobs;
+	counter.reset(new JobCounter);
+	tileRes = 0;
+	vertiTiles = 0;
+	horiTiles = 0;
+	budget = 16 << 20;
+	residentBytes = 0;
+	misses = 0;
+	horiChunks = 0;
+	vertiChunks = 0;
+	generation = 0;
+}
+
+TileStore::~TileStore()
+{
+	close();
+}
+
+bool TileStore::build(const string &file, char tileRes, int vertiTiles, int horiTiles, const string &bitMapName, const Generator &generate)
+{
+	cout << "Building " << file.c_str() << "... ";
+
+	int horiChunks = (horiTiles + CHUNK_MASK) >> CHUNK_BITS;
+	int vertiChunks = (vertiTiles + CHUNK_MASK) >> CHUNK_BITS;
+
+	vector<char> header(worldMagic, worldMagic + sizeof(worldMagic));
+	writeValue(header, worldVersion);
+	writeValue(header, (Uint8)CHUNK_BITS);
+	writeValue(header, tileRes);
+	writeValue(header, vertiTiles);
+	writeValue(header, horiTiles);
+	header.insert(header.end(), bitMapName.begin(), bitMapName.end());
+	header.push_back('\0');
+
+	//the index is only known at the end, chunks go after the room left for it
+	size_t indexSize = (size_t)horiChunks*vertiChunks*indexEntrySize;
+	vector<char> index;
+	index.reserve(indexSize);
+	Uint64 offset = header.size() + sizeof(Uint32) + indexSize;
+
+	ofstream stream(file.c_str(), ios::out | ios::binary);
+	stream.write(header.data(), header.size());
+	vector<char> room(sizeof(Uint32) + indexSize);
+	stream.write(room.data(), room.size());
+
+	vector<char> tiles(chunkTiles);
+	vector<char> encoded;
+	for (int y = 0; y < vertiChunks && stream; y++)
+	{
+		for (int x = 0; x < horiChunks; x++)
+		{
+			fill(tiles.begin(), tiles.end(), 0);
+			generate(x, y, tiles.data());
+
+			if (count(tiles.begin(), tiles.end(), tiles[0]) == (ptrdiff_t)tiles.size())
+			{
+				writeValue(index, (Uint64)0);
+				writeValue(index, (Uint32)0);
+				writeValue(index, (Uint32)0);
+				writeValue(index, tiles[0]);
+				continue;
+			}
+
+			encoded.clear();
+			encodeTiles(encoded, tiles.data(), tiles.size(), true);
+			stream.write(encoded.data(), encoded.size());
+			writeValue(index, offset);
+			writeValue(index, (Uint32)encoded.size());
+			writeValue(index, adler32(encoded.data(), encoded.size()));
+			writeValue(index, (char)0);
+			offset += encoded.size();
+		}
+	}
+
+	Uint32 checksum = adler32(index.data(), index.size());
+	stream.seekp(header.size());
+	stream.write((const char *)&checksum, sizeof(checksum));
+	stream.write(index.data(), index.size());
+	stream.close();
+
+	cout << (stream ? "Ok" : "Building failed") << endl;
+	return !stream.fail();
+}
+
+bool TileStore::open(const string &file)
+{
+	close();
+	cout << "Opening " << file.c_str() << "... ";
+
+	auto fail = [this](const char *reason)
+	{
+		cout << reason << endl;
+		close();
+		return false;
+	};
+
+	stream.open(file.c_str(), ios::in | ios::binary | ios::ate);
+	if (!stream) return fail("Opening failed");
+	Uint64 fileSize = (Uint64)stream.tellg();
+	stream.seekg(0);
+
+	char magic[4];
+	Uint16 version;
+	Uint8 chunkBits;
+	stream.read(magic, sizeof(magic));
+	stream.read((char *)&version, sizeof(version));
+	stream.read((char *)&chunkBits, sizeof(chunkBits));
+	stream.read(&tileRes, sizeof(tileRes));
+	stream.read((char *)&vertiTiles, sizeof(vertiTiles));
+	stream.read((char *)&horiTiles, sizeof(horiTiles));
+	getline(stream, bitMapName, '\0');
+	if (!stream || memcmp(magic, worldMagic, sizeof(magic))) return fail("not a world file");
+	if (version > worldVersion || chunkBits != CHUNK_BITS) return fail("unsupported world version");
+	if (tileRes <= 0 || vertiTiles < 0 || horiTiles < 0) return fail("Opening failed");
+
+	horiChunks = (horiTiles + CHUNK_MASK) >> CHUNK_BITS;
+	vertiChunks = (vertiTiles + CHUNK_MASK) >> CHUNK_BITS;
+	size_t chunkCount = (size_t)horiChunks*vertiChunks;
+	if (chunkCount*indexEntrySize > fileSize) return fail("Opening failed");
+
+	Uint32 checksum;
+	vector<char> index(chunkCount*indexEntrySize);
+	stream.read((char *)&checksum, sizeof(checksum));
+	stream.read(index.data(), index.size());
+	if (!stream || adler32(index.data(), index.size()) != checksum) return fail("index is corrupt");
+
+	MapReader reader = { index.data(), index.data() + index.size() };
+	chunks.resize(chunkCount);
+	for (auto &chunk : chunks)
+	{
+		reader.read(chunk.offset);
+		reader.read(chunk.size);
+		reader.read(chunk.checksum);
+		reader.read(chunk.type);
+		if (chunk.size && chunk.offset + chunk.size > fileSize) return fail("index is corrupt");
+		chunk.tiles = nullptr;
+		chunk.loading = false;
+		chunk.lastUsed = 0;
+	}
+
+	fileName = file;
+	cout << "Ok" << endl;
+	return true;
+}
+
+void TileStore::close()
+{
+	if (jobs) jobs->wait(*counter);
+	stream.close();
+	stream.clear();
+	fileName.clear();
+	tileRes = 0;
+	vertiTiles = horiTiles = 0;
+	horiChunks = vertiChunks = 0;
+	chunks.clear();
+	resident.clear();
+	spareBlocks.clear();
+	blocks.clear();
+	queued.clear();
+	finished.clear();
+	residentBytes = 0;
+	misses = 0;
+	generation = 0;
+}
+
+char TileStore::pageIn(int x, int y)
+{
+	unsigned index = (y >> CHUNK_BITS)*horiChunks + (x >> CHUNK_BITS);
+	StoredChunk &chunk = chunks[index];
+	misses++;
+
+	//if a prefetch of it is still on the way, its result is dropped in install
+	vector<ChunkRead> reads(1, ChunkRead{ index, chunk.offset, chunk.size, chunk.checksum, {}, false });
+	readChunks(stream, reads);
+	install(reads[0]);
+	chunk.lastUsed = generation;
+	return getTile(x, y);
+}
+
+void TileStore::readChunks(ifstream &in, vector<ChunkRead> &reads)
+{
+	sort(reads.begin(), reads.end(), [](const ChunkRead &a, const ChunkRead &b) { return a.offset < b.offset; });
+
+	vector<char> data;
+	for (auto &read : reads)
+	{
+		data.resize(read.size);
+		in.clear();
+		in.seekg(read.offset);
+		in.read(data.data(), data.size());
+
+		read.tiles.resize(chunkTiles);
+		MapReader reader = { data.data(), data.data() + data.size() };
+		Uint8 encoding;
+		read.ok = in && adler32(data.data(), data.size()) == read.checksum
+			&& reader.read(encoding) && decodeTiles(reader, encoding, chunkTiles, read.tiles.data());
+	}
+}
+
+void TileStore::install(const ChunkRead &read)
+{
+	StoredChunk &chunk = chunks[read.index];
+	if (!read.ok)
+	{
+		//treated as empty from now on, so it isn't read over and over again
+		cout << "chunk " << read.index % horiChunks << "," << read.index / horiChunks << " of " << fileName.c_str() << " is corrupt" << endl;
+		chunk.size = 0;
+		chunk.type = 0;
+		return;
+	}
+	if (chunk.tiles) return;
+
+	char *block;
+	if (spareBlocks.empty())
+	{
+		blocks.emplace_back(new char[chunkTiles]);
+		block = blocks.back().get();
+	}
+	else
+	{
+		block = spareBlocks.back();
+		spareBlocks.pop_back();
+	}
+
+	memcpy(block, read.tiles.data(), chunkTiles);
+	chunk.tiles = block;
+	resident.push_back(read.index);
+	residentBytes += chunkTiles;
+}
+
+void TileStore::prefetch(int x1, int y1, int x2, int y2)
+{
+	x1 = max(x1, 0);
+	y1 = max(y1, 0);
+	x2 = min(x2, horiTiles - 1);
+	y2 = min(y2, vertiTiles - 1);
+	if (x1 > x2 || y1 > y2) return;
+
+	vector<ChunkRead> reads;
+	for (int y = y1 >> CHUNK_BITS; y <= y2 >> CHUNK_BITS; y++)
+	{
+		for (int x = x1 >> CHUNK_BITS; x <= x2 >> CHUNK_BITS; x++)
+		{
+			unsigned index = y*horiChunks + x;
+			StoredChunk &chunk = chunks[index];
+			chunk.lastUsed = generation;
+			if (chunk.tiles || !chunk.size || chunk.loading) continue;
+
+			chunk.loading = true;
+			reads.push_back(ChunkRead{ index, chunk.offset, chunk.size, chunk.checksum, {}, false });
+		}
+	}
+	if (reads.empty()) return;
+
+	if (!jobs)
+	{
+		queued.insert(queued.end(), make_move_iterator(reads.begin()), make_move_iterator(reads.end()));
+		return;
+	}
+
+	//one job per prefetch, the chunks of an area are mostly next to each other in the file
+	shared_ptr<vector<ChunkRead>> batch = make_shared<vector<ChunkRead>>(move(reads));
+	jobs->submit([this, batch]()
+	{
+		ifstream in(fileName.c_str(), ios::in | ios::binary);
+		readChunks(in, *batch);
+
+		lock_guard<mutex> guard(lock);
+		finished.insert(finished.end(), make_move_iterator(batch->begin()), make_move_iterator(batch->end()));
+	}, *counter);
+}
+
+unsigned TileStore::poll()
+{
+	vector<ChunkRead> ready;
+	if (!jobs)
+	{
+		//nobody else to read them
+		readChunks(stream, queued);
+		ready.swap(queued);
+	}
+	else
+	{
+		lock_guard<mutex> guard(lock);
+		ready.swap(finished);
+	}
+
+	for (auto &read : ready)
+	{
+		chunks[read.index].loading = false;
+		install(read);
+	}
+
+	pageOut();
+	generation++;
+	return ready.size();
+}
+
+void TileStore::pageOut()
+{
+	if (residentBytes <= budget) return;
+
+	//least recently wanted first, down to a quarter below budget so it doesn't have to run again right away
+	sort(resident.begin(), resident.end(), [this](unsigned a, unsigned b) { return chunks[a].lastUsed < chunks[b].lastUsed; });
+	size_t target = budget - budget / 4;
+	size_t i = 0;
+	for (; i < resident.size() && residentBytes > target; i++)
+	{
+		StoredChunk &chunk = chunks[resident[i]];
+		if (chunk.lastUsed == generation) break;	//sorted, everything after is wanted too
+
+		spareBlocks.push_back(chunk.tiles);
+		chunk.tiles = nullptr;
+		residentBytes -= chunkTiles;
+	}
+	resident.erase(resident.begin(), resident.begin() + i);
+}
+
+void TileStore::copyArea(int x, int y, int w, int h, char *out)
+{
+	for (int j = 0; j < h; j++)
+	{
+		for (int i = 0; i < w; i++) *out++ = getTile(x + i, y + j);
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class JobSystem;
+struct JobCounter;
+
+//tiles of a world too big to keep in memory, cut into square chunks in a file with an index in front
+//so any chunk is one seek away, chunks made of a single tile type live in the index alone and never take memory
+//the rest are paged in around the areas handed to prefetch, read on the job system, and paged out
+//least recently wanted first once they take more than budget
+class TileStore
+{
+public:
+	static const int CHUNK_BITS = 6;
+	static const int CHUNK_SIZE = 1 << CHUNK_BITS;	//chunks are CHUNK_SIZE*CHUNK_SIZE tiles
+	static const int CHUNK_MASK = CHUNK_SIZE - 1;
+
+	//fills the chunk at chunkX,chunkY, tiles are in rows of CHUNK_SIZE and start out as 0
+	typedef function<void(int chunkX, int chunkY, char *tiles)> Generator;
+
+	TileStore(JobSystem *_jobs = nullptr);	//without a job system prefetched chunks are read on the main thread in poll
+	~TileStore();	//waits for reads still running
+
+	//writes a world file a chunk at a time, so the world never has to fit in memory while it's made
+	static bool build(const string &file, char tileRes, int vertiTiles, int horiTiles, const string &bitMapName, const Generator &generate);
+	bool open(const string &file);	//reads the header and the index, no tiles
+	void close();
+
+	//main thread only, a chunk that isn't resident yet is read right away, which counts as a miss
+	inline char getTile(int x, int y);
+	//marks the chunks over the inclusive tile area as wanted and queues reads of the missing ones
+	void prefetch(int x1, int y1, int x2, int y2);
+	//main thread only, takes in finished reads and pages out chunks over budget, returns how many came in
+	//prefetch every area that will be needed first, poll once a frame after that
+	unsigned poll();
+	void copyArea(int x, int y, int w, int h, char *out);	//rows of w tiles, outside the world is 0
+
+	char tileRes;
+	int vertiTiles;		//size of the world in tiles
+	int horiTiles;
+	string bitMapName;
+	size_t budget;			//bytes of resident chunks, chunks wanted since the last poll stay even above it
+	size_t residentBytes;
+	unsigned misses;		//chunks getTile had to wait for
+
+private:
+	struct StoredChunk
+	{
+		char *tiles;		//nullptr while paged out and for uniform chunks
+		Uint64 offset;		//of the encoded tiles in the file
+		Uint32 size;		//0 for uniform chunks, every tile of them is type
+		Uint32 checksum;
+		char type;
+		bool loading;		//a read is queued or running
+		unsigned lastUsed;	//poll the chunk was last wanted before
+	};
+
+	//a chunk read off the main thread, the file position is copied so the reader never touches chunks
+	struct ChunkRead
+	{
+		unsigned index;
+		Uint64 offset;
+		Uint32 size;
+		Uint32 checksum;
+		vector<char> tiles;
+		bool ok;
+	};
+
+	char pageIn(int x, int y);	//the slow path of getTile
+	static void readChunks(ifstream &in, vector<ChunkRead> &reads);	//in file order
+	void install(const ChunkRead &read);
+	void pageOut();
+
+	JobSystem *jobs;
+	unique_ptr<JobCounter> counter;
+	string fileName;
+	ifstream stream;	//for misses, reads on the job system open their own
+	int horiChunks;
+	int vertiChunks;
+	vector<StoredChunk> chunks;	//in rows
+	vector<unsigned> resident;	//indices of chunks with tiles
+	vector<unique_ptr<char[]>> blocks;	//every chunk buffer ever allocated, paged out ones are reused
+	vector<char*> spareBlocks;
+	unsigned generation;	//counts polls
+
+	mutex lock;
+	vector<ChunkRead> queued;	//not read yet, only used without a job system
+	vector<ChunkRead> finished;	//read, waiting for poll
+};
+
+inline char TileStore::getTile(int x, int y)
+{
+	if (x < 0 || y < 0 || x >= horiTiles || y >= vertiTiles) return 0;
+	const StoredChunk &chunk = chunks[(y >> CHUNK_BITS)*horiChunks + (x >> CHUNK_BITS)];
+	if (chunk.tiles) return chunk.tiles[((y & CHUNK_MASK) << CHUNK_BITS) + (x & CHUNK_MASK)];
+	if (!chunk.size) return chunk.type;
+	return pageIn(x, y);
+}
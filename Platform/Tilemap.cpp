@@ -1,160 +1,1338 @@
 #include "Tilemap.h"
+#include "AssetCache.h"
+#include "MapFormat.h"
+#include "TileStore.h"
 #include <fstream>
+#include <algorithm>
 #include <string>
+#include <cstring>
+#include <cmath>
+#include <limits>
 
 
 using namespace std;
 
 Tilemap::Tilemap()
 {
+	sprites = nullptr;
+	assets = nullptr;
+	tileRes = 0;
+	vertiTiles = 0;
+	horiTiles = 0;
 
+	chunkSize = 16;
+	maxChunks = 64;
+	updateCounter = 0;
+	batched = false;
+	batchDirty = true;
+	batchView = { 0, 0, 0, 0 };
+	wrapped = false;
+	ring = nullptr;
+	ringW = ringH = 0;
+	ringX = ringY = 0;
+	ringValid = false;
+	ringTransparent = false;
+	maskWords = 0;
+	solidVersion = 0;
+	for (int i = 0; i < 256; i++) tileFrames[i] = char(i);
 }
 Tilemap::Tilemap(Spritesheet *_sprites)
 {
 	sprites = _sprites;
+	assets = nullptr;
 	tileRes = 0;
 	vertiTiles = 0;
 	horiTiles = 0;
 
-	fullTex = nullptr;
+	chunkSize = 16;
+	maxChunks = 64;
+	updateCounter = 0;
+	batched = false;
+	batchDirty = true;
+	batchView = { 0, 0, 0, 0 };
+	wrapped = false;
+	ring = nullptr;
+	ringW = ringH = 0;
+	ringX = ringY = 0;
+	ringValid = false;
+	ringTransparent = false;
+	maskWords = 0;
+	solidVersion = 0;
+	for (int i = 0; i < 256; i++) tileFrames[i] = char(i);
 }
 
 Tilemap::~Tilemap()
 {
-	SDL_DestroyTexture(fullTex);
+	clearChunks();
+	if (assets && sprites) assets->release(sprites);
 }
 
-void Tilemap::loadFile(const string &_file)
+//.map layout, version 1
+//	magic "PMAP", Uint16 version, Uint16 section count
+//	every section: 4 character id, Uint32 payload size, Uint32 adler-32 of payload, payload
+//	"INFO": char tileRes, int vertiTiles, int horiTiles, bitMapName + '\0'
+//	"TILE": Uint8 encoding (MAP_RAW or MAP_RLE), then vertiTiles*horiTiles tiles or (count, type) byte pairs
+//	"LAYR": float scrollX, float scrollY, Uint8 flags (LAYER_STATIC, LAYER_FOREGROUND), then tiles like "TILE", one section per layer in order
+//	"ANIM": Uint16 count, then for every animated type char type, Uint32 frameDelay, Uint8 frame count, the frames
+//unknown sections are skipped
+//the legacy layout is the INFO payload immediately followed by raw tiles, without any header
+static const char mapMagic[4] = { 'P', 'M', 'A', 'P' };
+static const Uint16 mapVersion = 1;
+
+enum LayerFlags : Uint8
 {
-	fstream file;
-	file.open(_file.c_str(), ios::in | ios::binary);
+	LAYER_STATIC = 1,
+	LAYER_FOREGROUND = 2
+};
 
-	file.read((char *)&tileRes, sizeof(tileRes));
-	file.read((char *)&vertiTiles, sizeof(vertiTiles));
-	file.read((char *)&horiTiles, sizeof(horiTiles));
+static void writeSection(vector<char> &out, const char id[4], const vector<char> &payload)
+{
+	out.insert(out.end(), id, id + 4);
+	writeValue(out, (Uint32)payload.size());
+	writeValue(out, adler32(payload.data(), payload.size()));
+	out.insert(out.end(), payload.begin(), payload.end());
+}
 
-	char tempChar;
+bool Tilemap::loadFile(const string &_file)
+{
+	cout << "Loading " << _file.c_str() << "... ";
 
-	file.read((char *)&tempChar, sizeof(tempChar));
-	while (tempChar)
+	//read the whole file in one go, everything after this works on memory
+	ifstream file(_file.c_str(), ios::in | ios::binary | ios::ate);
+	if (!file)
 	{
-		bitMapName += tempChar;
-		file.read((char *)&tempChar, sizeof(tempChar));
+		cout << "Loading failed" << endl;
+		return false;
 	}
+	vector<char> data((size_t)file.tellg());
+	file.seekg(0);
+	file.read(data.data(), data.size());
+	file.close();
+
+	clearChunks();
+	bitMapName.clear();
+	tiles.clear();
+	layers.clear();
+	animations.clear();
+	for (int i = 0; i < 256; i++) tileFrames[i] = char(i);
 
-	for (int i = 0; i < vertiTiles; i++)
+	MapReader reader = { data.data(), data.data() + data.size() };
+	bool ok;
+	if (data.size() >= sizeof(mapMagic) && !memcmp(data.data(), mapMagic, sizeof(mapMagic))) ok = readSections(reader);
+	else ok = readInfo(reader) && readTiles(reader, MAP_RAW, tiles);
+
+	if (!ok)
 	{
-		for (int j = 0; j < horiTiles; j++)
+		vertiTiles = horiTiles = 0;
+		tiles.clear();
+		layers.clear();
+	}
+
+	dirtyTiles.clear();
+	dirtyMask.assign(tiles.size(), false);
+	buildSolidIndex();
+
+	cout << (ok ? "Ok" : "Loading failed") << endl;
+	if (ok) acquireSprites();
+	return ok;
+}
+
+bool Tilemap::saveFile(const string &_file, bool compress)
+{
+	vector<char> info;
+	writeValue(info, tileRes);
+	writeValue(info, vertiTiles);
+	writeValue(info, horiTiles);
+	info.insert(info.end(), bitMapName.begin(), bitMapName.end());
+	info.push_back('\0');
+
+	vector<char> tileData;
+	encodeTiles(tileData, tiles.data(), tiles.size(), compress);
+
+	vector<char> out(mapMagic, mapMagic + sizeof(mapMagic));
+	writeValue(out, mapVersion);
+	writeValue(out, (Uint16)(2 + layers.size() + (animations.empty() ? 0 : 1)));
+	writeSection(out, "INFO", info);
+	writeSection(out, "TILE", tileData);
+
+	for (auto &layer : layers)
+	{
+		vector<char> layerData;
+		writeValue(layerData, layer.scrollX);
+		writeValue(layerData, layer.scrollY);
+		writeValue(layerData, (Uint8)((layer.isStatic ? LAYER_STATIC : 0) | (layer.foreground ? LAYER_FOREGROUND : 0)));
+		encodeTiles(layerData, layer.tiles.data(), layer.tiles.size(), compress);
+		writeSection(out, "LAYR", layerData);
+	}
+
+	if (!animations.empty())
+	{
+		//in type order, so the same map always saves to the same bytes
+		vector<char> types;
+		for (auto &i : animations) types.push_back(i.first);
+		sort(types.begin(), types.end());
+
+		vector<char> animationData;
+		writeValue(animationData, (Uint16)animations.size());
+		for (char type : types)
 		{
-			file.read((char *)&tempChar, sizeof(tempChar));
-			tiles.push_back(tempChar);
+			const TileAnimation &animation = animations.at(type);
+			//the frame count is a single byte in the file
+			if (animation.frames.size() > 255)
+			{
+				cout << "Saving " << _file.c_str() << " failed, tile " << (int)type << " has " << animation.frames.size() << " animation frames, at most 255 fit" << endl;
+				return false;
+			}
+			writeValue(animationData, type);
+			writeValue(animationData, (Uint32)animation.frameDelay);
+			writeValue(animationData, (Uint8)animation.frames.size());
+			animationData.insert(animationData.end(), animation.frames.begin(), animation.frames.end());
 		}
+		writeSection(out, "ANIM", animationData);
 	}
 
+	ofstream file(_file.c_str(), ios::out | ios::binary);
+	file.write(out.data(), out.size());
 	file.close();
+
+	if (!file)
+	{
+		cout << "Saving " << _file.c_str() << " failed" << endl;
+		return false;
+	}
+	return true;
 }
 
-void Tilemap::saveFile(const string &_file)
+bool Tilemap::readSections(MapReader &reader)
 {
-	fstream file;
-	file.open(_file.c_str(), ios::out | ios::binary);
+	reader.pos += sizeof(mapMagic);
 
-	file.write((char *)&tileRes, sizeof(tileRes));
-	file.write((char *)&vertiTiles, sizeof(vertiTiles));
-	file.write((char *)&horiTiles, sizeof(horiTiles));
-	file << bitMapName << '\0';
+	Uint16 version, sectionCount;
+	if (!reader.read(version) || !reader.read(sectionCount)) return false;
+	if (version > mapVersion)
+	{
+		cout << "unsupported map version " << version << ", ";
+		return false;
+	}
 
-	for (auto it = begin(tiles); it != end(tiles); ++it)
+	bool hasInfo = false;
+	bool hasTiles = false;
+	for (unsigned i = 0; i < sectionCount; i++)
 	{
-		file.write((char *)&*it, sizeof(char));
+		char id[4];
+		Uint32 size, checksum;
+		if (!reader.read(id) || !reader.read(size) || !reader.read(checksum)) return false;
+		if (reader.end - reader.pos < (ptrdiff_t)size) return false;
+		if (adler32(reader.pos, size) != checksum)
+		{
+			cout << "section " << string(id, 4) << " is corrupt, ";
+			return false;
+		}
+
+		MapReader section = { reader.pos, reader.pos + size };
+		reader.pos += size;
+
+		if (!memcmp(id, "INFO", 4))
+		{
+			//a second one would change the size under tiles and layers read for the first
+			if (hasInfo || !readInfo(section)) return false;
+			hasInfo = true;
+		}
+		else if (!memcmp(id, "TILE", 4))
+		{
+			Uint8 encoding;
+			if (!hasInfo || !section.read(encoding) || !readTiles(section, encoding, tiles)) return false;
+			hasTiles = true;
+		}
+		else if (!memcmp(id, "LAYR", 4))
+		{
+			if (!hasInfo || !readLayer(section)) return false;
+		}
+		else if (!memcmp(id, "ANIM", 4))
+		{
+			if (!readAnimations(section)) return false;
+		}
 	}
 
-	file.close();
+	return hasInfo && hasTiles;
+}
+
+bool Tilemap::readInfo(MapReader &reader)
+{
+	if (!reader.read(tileRes) || !reader.read(vertiTiles) || !reader.read(horiTiles) || !reader.readString(bitMapName)) return false;
+	//cells are indexed with int everywhere else
+	return tileRes > 0 && vertiTiles >= 0 && horiTiles >= 0 && (Sint64)vertiTiles*horiTiles <= numeric_limits<int>::max();
+}
+
+bool Tilemap::readLayer(MapReader &reader)
+{
+	TileLayer layer;
+	Uint8 flags, encoding;
+	if (!reader.read(layer.scrollX) || !reader.read(layer.scrollY) || !reader.read(flags) || !reader.read(encoding)) return false;
+	if (!readTiles(reader, encoding, layer.tiles)) return false;
+
+	layer.isStatic = (flags & LAYER_STATIC) != 0;
+	layer.foreground = (flags & LAYER_FOREGROUND) != 0;
+	layers.push_back(move(layer));
+	return true;
+}
+
+//the cells are indexed once the tiles are in, by buildSolidIndex
+bool Tilemap::readAnimations(MapReader &reader)
+{
+	Uint16 count;
+	if (!reader.read(count)) return false;
+	for (unsigned i = 0; i < count; i++)
+	{
+		char type;
+		Uint32 frameDelay;
+		Uint8 frameCount;
+		if (!reader.read(type) || !reader.read(frameDelay) || !reader.read(frameCount) || !frameCount) return false;
+		if (reader.end - reader.pos < frameCount) return false;
+
+		TileAnimation &animation = animations[type];
+		animation.frames.assign(reader.pos, reader.pos + frameCount);
+		animation.frameDelay = frameDelay;
+		animation.counter = frameDelay;
+		animation.currentFrame = 0;
+		tileFrames[(Uint8)type] = animation.frames[0];
+		reader.pos += frameCount;
+	}
+	return true;
+}
+
+bool Tilemap::readTiles(MapReader &reader, Uint8 encoding, vector<char> &out)
+{
+	//a broken size would otherwise be allocated before the payload runs out
+	size_t count = (size_t)vertiTiles*(size_t)horiTiles;
+	if (!tilesFit(reader, encoding, count)) return false;
+	out.resize(count);
+	return decodeTiles(reader, encoding, count, out.data());
 }
 
 void Tilemap::update(Window *window)
-{	
-	if (fullTex) SDL_DestroyTexture(fullTex); 
-	
-	//render to tempTex instead of window
-	//tempTex is needed because it can't be rendered??
-	SDL_Texture *tempTex = SDL_CreateTexture(window->ren, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_TARGET, window->area.w, window->area.h);
-	SDL_SetRenderTarget(window->ren, tempTex);
-
-	//clear texture
-	SDL_SetRenderDrawColor(window->ren, 0, 0, 0, 255);
-	SDL_RenderClear(window->ren);
+{
+	updateCounter++;
+
+	animateTiles();
+	if (wrapped) updateRing(window);
+	flushDirty(window);
+	redrawStepped(window);
+
+	for (auto &layer : layers)
+	{
+		if (layer.isStatic) cacheChunks(layer.chunks, layer.tiles, true, viewOf(window, layer.scrollX, layer.scrollY), window);
+	}
+
+	if (batched && sprites->useAtlas)
+	{
+		SDL_Rect view = viewOf(window);
+		if (batchDirty || view.x != batchView.x || view.y != batchView.y || view.w != batchView.w || view.h != batchView.h)
+		{
+			buildBatch(tiles, view, viewBatch, view.x, view.y);
+			batchView = view;
+			batchDirty = false;
+		}
+		return;
+	}
+
+	if (!wrapped) cacheChunks(chunks, tiles, hasBackground(), viewOf(window), window);
+}
+
+void Tilemap::render(Window *window)
+{
+	for (auto &layer : layers)
+	{
+		if (!layer.foreground) renderLayer(layer, window);
+	}
+
+	if (batched && sprites->useAtlas) viewBatch.submit(window->ren);
+	else if (wrapped) renderRing(window);
+	else renderChunks(chunks, viewOf(window), window);
+}
+
+void Tilemap::renderForeground(Window *window)
+{
+	for (auto &layer : layers)
+	{
+		if (layer.foreground) renderLayer(layer, window);
+	}
+}
+
+void Tilemap::renderLayer(TileLayer &layer, Window *window)
+{
+	SDL_Rect view = viewOf(window, layer.scrollX, layer.scrollY);
+
+	//static layers only composite their cached chunks, dynamic ones are drawn from their tiles every time
+	if (layer.isStatic) renderChunks(layer.chunks, view, window);
+	else drawTiles(layer.tiles, view, view.x, view.y, window);
+}
+
+//modulo that stays positive for negative tile or pixel positions
+static inline int wrapAround(int a, int n)
+{
+	a %= n;
+	return a < 0 ? a + n : a;
+}
+
+static inline int floorDiv(int a, int b)
+{
+	return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+void Tilemap::updateRing(Window *window)
+{
+	SDL_Rect view = viewOf(window);
+	int w = (view.w + tileRes - 1) / tileRes + 1;
+	int h = (view.h + tileRes - 1) / tileRes + 1;
+	bool transparent = hasBackground();
+
+	//only allocated again when the window size changes
+	if (!ring || w != ringW || h != ringH || transparent != ringTransparent)
+	{
+		if (ring) SDL_DestroyTexture(ring);
+		ringW = w;
+		ringH = h;
+		ringTransparent = transparent;
+		ring = SDL_CreateTexture(window->ren, transparent ? SDL_PIXELFORMAT_RGBA8888 : SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_TARGET, w*tileRes, h*tileRes);
+		if (transparent) SDL_SetTextureBlendMode(ring, SDL_BLENDMODE_BLEND);
+		ringValid = false;
+	}
+
+	int firstX = floorDiv(view.x, tileRes);
+	int firstY = floorDiv(view.y, tileRes);
+
+	SDL_SetRenderTarget(window->ren, ring);
+
+	if (!ringValid || abs(firstX - ringX) >= ringW || abs(firstY - ringY) >= ringH)
+	{
+		ringX = firstX;
+		ringY = firstY;
+		ringValid = true;
+		drawRingTiles(ringX, ringY, ringX + ringW - 1, ringY + ringH - 1, window);
+	}
+	else
+	{
+		//slide the window the ring holds and draw just the columns and rows that entered it
+		int oldX = ringX;
+		int oldY = ringY;
+		ringX = firstX;
+		ringY = firstY;
+		if (ringX > oldX) drawRingTiles(oldX + ringW, ringY, ringX + ringW - 1, ringY + ringH - 1, window);
+		else if (ringX < oldX) drawRingTiles(ringX, ringY, oldX - 1, ringY + ringH - 1, window);
+		if (ringY > oldY) drawRingTiles(ringX, oldY + ringH, ringX + ringW - 1, ringY + ringH - 1, window);
+		else if (ringY < oldY) drawRingTiles(ringX, ringY, ringX + ringW - 1, oldY - 1, window);
+	}
 
-	//copy tiles to texture according to window offset
-	for (int i = 0; i < window->area.h / tileRes; i++)
+	//edited and animated tiles the ring holds, flushDirty takes care of the chunks and clears the list
+	scratchCells.clear();
+	scratchRects.clear();
+	for (auto &in : dirtyTiles)
 	{
-		int y = i + window->offsetY;
-		if (y < 0 || y >= vertiTiles) continue;
-		for (int j = 0; j < window->area.w / tileRes; j++)
+		int x = in % horiTiles;
+		int y = in / horiTiles;
+		if (x < ringX || y < ringY || x >= ringX + ringW || y >= ringY + ringH) continue;
+
+		SDL_Rect rect;
+		rect.x = wrapAround(x, ringW)*tileRes;
+		rect.y = wrapAround(y, ringH)*tileRes;
+		rect.w = rect.h = tileRes;
+		scratchCells.push_back(in);
+		scratchRects.push_back(rect);
+	}
+	drawCells(tiles, scratchCells.data(), scratchRects.data(), scratchCells.size(), ringTransparent, window);
+
+	SDL_SetRenderTarget(window->ren, NULL);
+}
+
+void Tilemap::drawRingTiles(int x1, int y1, int x2, int y2, Window *window)
+{
+	x1 = max(x1, ringX);
+	y1 = max(y1, ringY);
+	x2 = min(x2, ringX + ringW - 1);
+	y2 = min(y2, ringY + ringH - 1);
+	if (x1 > x2 || y1 > y2) return;
+
+	//every cell lands where its tile position wraps to, cleared first since the old tile is still there
+	scratchRects.clear();
+	if (sprites->useAtlas) scratchBatch.begin(sprites->atlas);
+	for (int y = y1; y <= y2; y++)
+	{
+		for (int x = x1; x <= x2; x++)
 		{
-			
-			int x = j + window->offsetX;
-			if (x < 0 || x >= horiTiles) continue;
+			SDL_Rect rect;
+			rect.x = wrapAround(x, ringW)*tileRes;
+			rect.y = wrapAround(y, ringH)*tileRes;
+			rect.w = rect.h = tileRes;
+			scratchRects.push_back(rect);
 
-			int in = y*horiTiles + x;
+			if (x < 0 || y < 0 || x >= horiTiles || y >= vertiTiles) continue;
+			char type = tiles[y*horiTiles + x];
+			if (type == EMPTY_TILE) continue;
+			if (sprites->useAtlas) scratchBatch.add(sprites->getClip(frameOf(type)), rect);
+		}
+	}
 
-			SDL_Texture *tex;
-			tex = sprites->frames[tiles[in]];
+	SDL_SetRenderDrawColor(window->ren, 0, 0, 0, ringTransparent ? 0 : 255);
+	SDL_RenderFillRects(window->ren, scratchRects.data(), scratchRects.size());
+
+	if (sprites->useAtlas)
+	{
+		scratchBatch.submit(window->ren);
+		return;
+	}
+	for (int y = max(y1, 0); y <= y2 && y < vertiTiles; y++)
+	{
+		for (int x = max(x1, 0); x <= x2 && x < horiTiles; x++)
+		{
+			char type = tiles[y*horiTiles + x];
+			if (type == EMPTY_TILE) continue;
 
 			SDL_Rect rect;
-			rect.y = i*tileRes;
-			rect.x = j*tileRes;
+			rect.x = wrapAround(x, ringW)*tileRes;
+			rect.y = wrapAround(y, ringH)*tileRes;
 			rect.w = rect.h = tileRes;
-			SDL_RenderCopy(window->ren, tex, NULL, &rect);
+			SDL_RenderCopy(window->ren, sprites->getTexture(frameOf(type)), sprites->getClip(frameOf(type)), &rect);
 		}
 	}
-	fullTex = tempTex;
-	SDL_SetRenderTarget(window->ren, NULL);
 }
 
-void Tilemap::render(Window *window)
+void Tilemap::renderRing(Window *window)
 {
-	SDL_RenderCopy(window->ren, fullTex, NULL, NULL);
+	if (!ringValid) return;	//update wasn't called yet
+
+	//the view starts somewhere inside the ring and wraps at most once in each direction
+	SDL_Rect view = viewOf(window);
+	int ringPixelsW = ringW*tileRes;
+	int ringPixelsH = ringH*tileRes;
+	int sx = wrapAround(view.x, ringPixelsW);
+	int sy = wrapAround(view.y, ringPixelsH);
+	int w1 = min(view.w, ringPixelsW - sx);
+	int h1 = min(view.h, ringPixelsH - sy);
+	int w2 = view.w - w1;
+	int h2 = view.h - h1;
+
+	SDL_Rect src = { sx, sy, w1, h1 };
+	SDL_Rect dst = { 0, 0, w1, h1 };
+	SDL_RenderCopy(window->ren, ring, &src, &dst);
+	if (w2 > 0)
+	{
+		src = { 0, sy, w2, h1 };
+		dst = { w1, 0, w2, h1 };
+		SDL_RenderCopy(window->ren, ring, &src, &dst);
+	}
+	if (h2 > 0)
+	{
+		src = { sx, 0, w1, h2 };
+		dst = { 0, h1, w1, h2 };
+		SDL_RenderCopy(window->ren, ring, &src, &dst);
+	}
+	if (w2 > 0 && h2 > 0)
+	{
+		src = { 0, 0, w2, h2 };
+		dst = { w1, h1, w2, h2 };
+		SDL_RenderCopy(window->ren, ring, &src, &dst);
+	}
+}
+
+void Tilemap::cacheChunks(unordered_map<int, TileChunk> &cache, const vector<char> &source, bool transparent, const SDL_Rect &view, Window *window)
+{
+	int chunksWide = (horiTiles + chunkSize - 1) / chunkSize;
+
+	int firstX, firstY, lastX, lastY;
+	visibleChunks(view, firstX, firstY, lastX, lastY);
+
+	for (int cy = firstY; cy <= lastY; cy++)
+	{
+		for (int cx = firstX; cx <= lastX; cx++)
+		{
+			auto it = cache.find(cy*chunksWide + cx);
+
+			TileChunk &chunk = it == cache.end() ? loadChunk(cache, source, transparent, cx, cy, window) : it->second;
+			chunk.lastUsed = updateCounter;
+		}
+	}
+}
+
+void Tilemap::renderChunks(const unordered_map<int, TileChunk> &cache, const SDL_Rect &view, Window *window) const
+{
+	int chunkPixels = chunkSize*tileRes;
+	int chunksWide = (horiTiles + chunkSize - 1) / chunkSize;
+
+	int firstX, firstY, lastX, lastY;
+	visibleChunks(view, firstX, firstY, lastX, lastY);
+
+	//only a handful of chunk textures are composited per frame
+	for (int cy = firstY; cy <= lastY; cy++)
+	{
+		for (int cx = firstX; cx <= lastX; cx++)
+		{
+			auto it = cache.find(cy*chunksWide + cx);
+			if (it == cache.end()) continue;	//not cached yet, update wasn't called for this view
+
+			SDL_Rect rect;
+			rect.x = cx*chunkPixels - view.x;
+			rect.y = cy*chunkPixels - view.y;
+			rect.w = rect.h = chunkPixels;
+			SDL_RenderCopy(window->ren, it->second.tex, NULL, &rect);
+		}
+	}
 }
 
 void Tilemap::create(char _tileRes, unsigned _vertiTiles, unsigned _horiTiles, const string& _bitMapName)
 {
+	clearChunks();
+	layers.clear();
 	tileRes = _tileRes;
 	vertiTiles = _vertiTiles;
 	horiTiles = _horiTiles;
 	bitMapName = _bitMapName;
 	tiles.resize(_vertiTiles*_horiTiles);
+
+	dirtyTiles.clear();
+	dirtyMask.assign(tiles.size(), false);
+	buildSolidIndex();
+	acquireSprites();
 }
 
-void Tilemap::changeTile(unsigned x, unsigned y, char type, Window *window)
+void Tilemap::loadRegion(TileStore &store, int x, int y, int w, int h)
 {
-	tiles[y*horiTiles + x] = type;
-	if (fullTex) SDL_DestroyTexture(fullTex);
+	clearChunks();
+	layers.clear();
+	tileRes = store.tileRes;
+	vertiTiles = h;
+	horiTiles = w;
+	bitMapName = store.bitMapName;
+	tiles.resize(w*h);
+	store.copyArea(x, y, w, h, tiles.data());
 
-	//render to tempTex instead of window
-	//tempTex is needed because it can't be rendered??
-	SDL_Texture *tempTex = SDL_CreateTexture(window->ren, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_TARGET, window->area.w, window->area.h);
-	SDL_SetRenderTarget(window->ren, tempTex);
+	dirtyTiles.clear();
+	dirtyMask.assign(tiles.size(), false);
+	buildSolidIndex();
+	acquireSprites();
+}
 
-	SDL_RenderCopy(window->ren, fullTex, NULL, NULL);
+void Tilemap::acquireSprites()
+{
+	if (!assets) return;
 
+	//acquire before releasing so a sheet shared with the previous map isn't evicted in between
+	Spritesheet *next = assets->acquire(bitMapName, tileRes);
+	if (sprites) assets->release(sprites);
+	sprites = next;
+}
 
-	SDL_Texture *tex;
-	tex = sprites->frames[type];
+void Tilemap::changeTile(unsigned x, unsigned y, char type)
+{
+	int in = y*horiTiles + x;
+	if (tiles[in] == type) return;
 
-	SDL_Rect rect;
-	rect.y = y*tileRes;
-	rect.x = x*tileRes;
-	rect.w = rect.h = tileRes;
-	SDL_RenderCopy(window->ren, tex, NULL, &rect);
+	//keep the cells of animated types in step
+	auto from = animations.find(tiles[in]);
+	if (from != animations.end())
+	{
+		vector<int> &cells = from->second.cells[chunkOf(in)];
+		auto it = find(cells.begin(), cells.end(), in);
+		if (it != cells.end())
+		{
+			*it = cells.back();
+			cells.pop_back();
+		}
+	}
+	auto to = animations.find(type);
+	if (to != animations.end()) to->second.cells[chunkOf(in)].push_back(in);
 
-	SDL_DestroyTexture(tex);
+	bool solidChanged = isSolid(tiles[in]) != isSolid(type);
+	tiles[in] = type;
+	if (solidChanged)
+	{
+		updateDistances(x, y);
+		solidMask[y*maskWords + x / 64] ^= Uint64(1) << (x % 64);
+		solidVersion++;
+	}
 
-	fullTex = tempTex;
-	SDL_SetRenderTarget(window->ren, NULL);
+	markDirty(in);
+}
+
+void Tilemap::markDirty(int in)
+{
+	batchDirty = true;
+	if (!dirtyMask[in])
+	{
+		dirtyMask[in] = true;
+		dirtyTiles.push_back(in);
+	}
+}
+
+void Tilemap::animateTile(char type, const vector<char> &frames, unsigned frameDelay)
+{
+	auto it = animations.find(type);
+	bool added = it == animations.end();
+	if (frames.empty())
+	{
+		if (it == animations.end()) return;
+		tileFrames[(Uint8)type] = type;
+		markAnimated(type, it->second);
+		animations.erase(it);
+		return;
+	}
+
+	TileAnimation &animation = animations[type];
+	animation.frames = frames;
+	animation.frameDelay = frameDelay;
+	animation.counter = frameDelay;
+	animation.currentFrame = 0;
+	if (added)
+	{
+		for (int i = 0; i < (int)tiles.size(); i++)
+		{
+			if (tiles[i] == type) animation.cells[chunkOf(i)].push_back(i);
+		}
+	}
+
+	tileFrames[(Uint8)type] = frames[0];
+	markAnimated(type, animation);
+}
+
+void Tilemap::animateTiles()
+{
+	for (auto &i : animations)
+	{
+		TileAnimation &animation = i.second;
+		if (animation.counter)
+		{
+			animation.counter--;
+			continue;
+		}
+		animation.counter = animation.frameDelay;
+		animation.currentFrame++;
+		if (animation.currentFrame >= animation.frames.size()) animation.currentFrame = 0;
+
+		char frame = animation.frames[animation.currentFrame];
+		if (frame == tileFrames[(Uint8)i.first]) continue;
+		tileFrames[(Uint8)i.first] = frame;
+		markAnimated(i.first, animation);
+	}
+}
+
+//a screen full of water costs as much as the water tiles in it, whatever else is on screen
+//uncached chunks need nothing, they're drawn with the current frames once they are cached
+void Tilemap::markAnimated(char type, const TileAnimation &animation)
+{
+	batchDirty = true;
+	if (!layers.empty()) steppedTypes.push_back(type);
+
+	auto markChunk = [&](int key)
+	{
+		auto cells = animation.cells.find(key);
+		if (cells == animation.cells.end()) return;
+		for (auto &in : cells->second) markDirty(in);
+	};
+	for (auto &chunk : chunks) markChunk(chunk.first);
+	if (!wrapped || !ringValid) return;
+
+	//chunks the ring holds, cells it doesn't hold are skipped when the ring is drawn
+	int chunksWide = (horiTiles + chunkSize - 1) / chunkSize;
+	int lastX = min(ringX + ringW - 1, horiTiles - 1) / chunkSize;
+	int lastY = min(ringY + ringH - 1, vertiTiles - 1) / chunkSize;
+	for (int cy = max(ringY, 0) / chunkSize; cy <= lastY; cy++)
+	{
+		for (int cx = max(ringX, 0) / chunkSize; cx <= lastX; cx++) markChunk(cy*chunksWide + cx);
+	}
+}
+
+void Tilemap::indexAnimatedCells()
+{
+	TileAnimation *byType[256] = {};
+	for (auto &i : animations)
+	{
+		i.second.cells.clear();
+		byType[(Uint8)i.first] = &i.second;
+	}
+	if (animations.empty()) return;
+
+	for (int i = 0; i < (int)tiles.size(); i++)
+	{
+		TileAnimation *animation = byType[(Uint8)tiles[i]];
+		if (animation) animation->cells[chunkOf(i)].push_back(i);
+	}
 }
 
 char Tilemap::getTile(unsigned x, unsigned y) const
 {
 	return tiles[y*horiTiles + x];
+}
+
+int Tilemap::solidDistance(int x, int y, Direction direction) const
+{
+	const vector<Uint16> *table;
+	int stepX = 0;
+	int stepY = 0;
+	switch (direction)
+	{
+	case UP:	table = &distUp;	stepY = -1;	break;
+	case DOWN:	table = &distDown;	stepY = 1;	break;
+	case LEFT:	table = &distLeft;	stepX = -1;	break;
+	case RIGHT:	table = &distRight;	stepX = 1;	break;
+	default: return 0;
+	}
+
+	//a saturated entry only says the run is at least that long, hop over it and keep counting
+	int distance = 0;
+	while (x >= 0 && y >= 0 && x < horiTiles && y < vertiTiles)
+	{
+		Uint16 d = (*table)[y*horiTiles + x];
+		distance += d;
+		if (d < UINT16_MAX) break;
+		x += stepX*d;
+		y += stepY*d;
+	}
+	return distance;
+}
+
+void Tilemap::clearChunks()
+{
+	batchDirty = true;
+	if (ring)
+	{
+		SDL_DestroyTexture(ring);
+		ring = nullptr;
+	}
+	ringValid = false;
+	for (auto &i : chunks)
+	{
+		SDL_DestroyTexture(i.second.tex);
+	}
+	chunks.clear();
+
+	for (auto &layer : layers)
+	{
+		for (auto &i : layer.chunks)
+		{
+			SDL_DestroyTexture(i.second.tex);
+		}
+		layer.chunks.clear();
+	}
+}
+
+TileLayer& Tilemap::addLayer(float scrollX, float scrollY, bool isStatic, bool foreground)
+{
+	//the main tiles need transparency once something is behind them, so they get redrawn
+	if (!foreground) clearChunks();
+
+	layers.emplace_back();
+	TileLayer &layer = layers.back();
+	layer.tiles.assign(tiles.size(), EMPTY_TILE);
+	layer.scrollX = scrollX;
+	layer.scrollY = scrollY;
+	layer.isStatic = isStatic;
+	layer.foreground = foreground;
+	return layer;
+}
+
+void Tilemap::changeLayerTile(unsigned layer, unsigned x, unsigned y, char type)
+{
+	TileLayer &target = layers[layer];
+	int in = y*horiTiles + x;
+	if (target.tiles[in] == type) return;
+	target.tiles[in] = type;
+
+	//cached layers redraw the chunk in full the next time it is visible
+	if (target.isStatic)
+	{
+		int chunksWide = (horiTiles + chunkSize - 1) / chunkSize;
+		auto it = target.chunks.find((y / chunkSize)*chunksWide + x / chunkSize);
+		if (it != target.chunks.end())
+		{
+			SDL_DestroyTexture(it->second.tex);
+			target.chunks.erase(it);
+		}
+	}
+}
+
+bool Tilemap::hasBackground() const
+{
+	for (auto &layer : layers)
+	{
+		if (!layer.foreground) return true;
+	}
+	return false;
+}
+
+void Tilemap::visibleChunks(const SDL_Rect &view, int &firstX, int &firstY, int &lastX, int &lastY) const
+{
+	int chunkPixels = chunkSize*tileRes;
+	int chunksWide = (horiTiles + chunkSize - 1) / chunkSize;
+	int chunksHigh = (vertiTiles + chunkSize - 1) / chunkSize;
+
+	//view in pixels, offsets can be negative so round towards negative infinity
+	int left = view.x;
+	int top = view.y;
+	int right = left + view.w - 1;
+	int bottom = top + view.h - 1;
+
+	firstX = left >= 0 ? left / chunkPixels : -((-left + chunkPixels - 1) / chunkPixels);
+	firstY = top >= 0 ? top / chunkPixels : -((-top + chunkPixels - 1) / chunkPixels);
+	lastX = right >= 0 ? right / chunkPixels : -1;
+	lastY = bottom >= 0 ? bottom / chunkPixels : -1;
+
+	if (firstX < 0) firstX = 0;
+	if (firstY < 0) firstY = 0;
+	if (lastX >= chunksWide) lastX = chunksWide - 1;
+	if (lastY >= chunksHigh) lastY = chunksHigh - 1;
+}
+
+TileChunk& Tilemap::loadChunk(unordered_map<int, TileChunk> &cache, const vector<char> &source, bool transparent, int cx, int cy, Window *window)
+{
+	if (cache.size() >= maxChunks) evictChunk(cache);
+
+	int chunkPixels = chunkSize*tileRes;
+	int chunksWide = (horiTiles + chunkSize - 1) / chunkSize;
+
+	TileChunk &chunk = cache[cy*chunksWide + cx];
+	chunk.chunkX = cx;
+	chunk.chunkY = cy;
+	chunk.lastUsed = updateCounter;
+	if (transparent)
+	{
+		chunk.tex = SDL_CreateTexture(window->ren, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, chunkPixels, chunkPixels);
+		SDL_SetTextureBlendMode(chunk.tex, SDL_BLENDMODE_BLEND);
+	}
+	else chunk.tex = SDL_CreateTexture(window->ren, SDL_PIXELFORMAT_RGBX8888, SDL_TEXTUREACCESS_TARGET, chunkPixels, chunkPixels);
+
+	drawChunk(chunk, source, transparent, window);
+	return chunk;
+}
+
+void Tilemap::drawChunk(TileChunk &chunk, const vector<char> &source, bool transparent, Window *window)
+{
+	SDL_SetRenderTarget(window->ren, chunk.tex);
+
+	//clear texture, parts outside the map stay black, or see-through when there are layers behind
+	SDL_SetRenderDrawColor(window->ren, 0, 0, 0, transparent ? 0 : 255);
+	SDL_RenderClear(window->ren);
+
+	int chunkPixels = chunkSize*tileRes;
+	SDL_Rect area = { chunk.chunkX*chunkPixels, chunk.chunkY*chunkPixels, chunkPixels, chunkPixels };
+	drawTiles(source, area, area.x, area.y, window);
+
+	SDL_SetRenderTarget(window->ren, NULL);
+}
+
+void Tilemap::drawTiles(const vector<char> &source, const SDL_Rect &area, int offsetX, int offsetY, Window *window)
+{
+	if (sprites->useAtlas)
+	{
+		//all of it in one draw call
+		buildBatch(source, area, scratchBatch, offsetX, offsetY);
+		scratchBatch.submit(window->ren);
+		return;
+	}
+
+	int firstX, firstY, lastX, lastY;
+	tilesIn(area, firstX, firstY, lastX, lastY);
+
+	for (int y = firstY; y <= lastY; y++)
+	{
+		for (int x = firstX; x <= lastX; x++)
+		{
+			char type = source[y*horiTiles + x];
+			if (type == EMPTY_TILE) continue;
+
+			SDL_Rect rect;
+			rect.x = x*tileRes - offsetX;
+			rect.y = y*tileRes - offsetY;
+			rect.w = rect.h = tileRes;
+			SDL_RenderCopy(window->ren, sprites->getTexture(frameOf(type)), sprites->getClip(frameOf(type)), &rect);
+		}
+	}
+}
+
+void Tilemap::buildBatch(const vector<char> &source, const SDL_Rect &view, SpriteBatch &batch, int offsetX, int offsetY) const
+{
+	//every tile overlapping view, positioned relative to offsetX/offsetY in pixels
+	int firstX, firstY, lastX, lastY;
+	tilesIn(view, firstX, firstY, lastX, lastY);
+
+	batch.begin(sprites->atlas);
+	for (int y = firstY; y <= lastY; y++)
+	{
+		for (int x = firstX; x <= lastX; x++)
+		{
+			char type = source[y*horiTiles + x];
+			if (type == EMPTY_TILE) continue;
+
+			SDL_Rect rect;
+			rect.x = x*tileRes - offsetX;
+			rect.y = y*tileRes - offsetY;
+			rect.w = rect.h = tileRes;
+			batch.add(sprites->getClip(frameOf(type)), rect);
+		}
+	}
+}
+
+void Tilemap::tilesIn(const SDL_Rect &area, int &firstX, int &firstY, int &lastX, int &lastY) const
+{
+	firstX = area.x >= 0 ? area.x / tileRes : 0;
+	firstY = area.y >= 0 ? area.y / tileRes : 0;
+	lastX = area.x + area.w > 0 ? (area.x + area.w - 1) / tileRes : -1;
+	lastY = area.y + area.h > 0 ? (area.y + area.h - 1) / tileRes : -1;
+	if (lastX >= horiTiles) lastX = horiTiles - 1;
+	if (lastY >= vertiTiles) lastY = vertiTiles - 1;
+}
+
+SDL_Rect Tilemap::viewOf(Window *window, float scrollX, float scrollY) const
+{
+	SDL_Rect view = { int(window->offsetX*scrollX), int(window->offsetY*scrollY), window->area.w, window->area.h };
+	return view;
+}
+
+void Tilemap::flushDirty(Window *window)
+{
+	if (dirtyTiles.empty()) return;
+
+	//group edits by chunk so every chunk takes one render target change and one batch
+	sort(dirtyTiles.begin(), dirtyTiles.end(), [&](int a, int b) { return chunkOf(a) < chunkOf(b); });
+
+	bool transparent = hasBackground();
+	size_t last;
+	for (size_t first = 0; first < dirtyTiles.size(); first = last)
+	{
+		int key = chunkOf(dirtyTiles[first]);
+		for (last = first; last < dirtyTiles.size() && chunkOf(dirtyTiles[last]) == key; last++) dirtyMask[dirtyTiles[last]] = false;
+
+		auto it = chunks.find(key);
+		if (it == chunks.end()) continue;	//not cached, it will be drawn in full when it becomes visible
+
+		TileChunk &chunk = it->second;
+		scratchRects.clear();
+		for (size_t i = first; i < last; i++)
+		{
+			SDL_Rect rect;
+			rect.x = (dirtyTiles[i] % horiTiles - chunk.chunkX*chunkSize)*tileRes;
+			rect.y = (dirtyTiles[i] / horiTiles - chunk.chunkY*chunkSize)*tileRes;
+			rect.w = rect.h = tileRes;
+			scratchRects.push_back(rect);
+		}
+
+		SDL_SetRenderTarget(window->ren, chunk.tex);
+		drawCells(tiles, &dirtyTiles[first], scratchRects.data(), scratchRects.size(), transparent, window);
+	}
+	dirtyTiles.clear();
+
+	SDL_SetRenderTarget(window->ren, NULL);
+}
+
+//layers have no per-type cell index, the few cached chunks are searched instead
+void Tilemap::redrawStepped(Window *window)
+{
+	if (steppedTypes.empty()) return;
+
+	bool stepped[256] = {};
+	for (char type : steppedTypes) stepped[(Uint8)type] = true;
+	steppedTypes.clear();
+
+	for (auto &layer : layers)
+	{
+		for (auto &i : layer.chunks)
+		{
+			TileChunk &chunk = i.second;
+			scratchCells.clear();
+			scratchRects.clear();
+			int lastX = min((chunk.chunkX + 1)*chunkSize, horiTiles);
+			int lastY = min((chunk.chunkY + 1)*chunkSize, vertiTiles);
+			for (int y = chunk.chunkY*chunkSize; y < lastY; y++)
+			{
+				for (int x = chunk.chunkX*chunkSize; x < lastX; x++)
+				{
+					if (!stepped[(Uint8)layer.tiles[y*horiTiles + x]]) continue;
+					SDL_Rect rect;
+					rect.x = (x - chunk.chunkX*chunkSize)*tileRes;
+					rect.y = (y - chunk.chunkY*chunkSize)*tileRes;
+					rect.w = rect.h = tileRes;
+					scratchCells.push_back(y*horiTiles + x);
+					scratchRects.push_back(rect);
+				}
+			}
+			if (scratchCells.empty()) continue;
+
+			SDL_SetRenderTarget(window->ren, chunk.tex);
+			drawCells(layer.tiles, scratchCells.data(), scratchRects.data(), scratchCells.size(), true, window);
+		}
+	}
+	SDL_SetRenderTarget(window->ren, NULL);
+}
+
+void Tilemap::drawCells(const vector<char> &source, const int *cells, const SDL_Rect *rects, unsigned count, bool transparent, Window *window)
+{
+	if (!count) return;
+
+	//clear the cells first so transparent parts of the new tiles don't show the old ones
+	SDL_SetRenderDrawColor(window->ren, 0, 0, 0, transparent ? 0 : 255);
+	SDL_RenderFillRects(window->ren, rects, count);
+
+	if (sprites->useAtlas) scratchBatch.begin(sprites->atlas);
+	for (unsigned i = 0; i < count; i++)
+	{
+		char type = source[cells[i]];
+		if (type == EMPTY_TILE) continue;
+
+		if (sprites->useAtlas) scratchBatch.add(sprites->getClip(frameOf(type)), rects[i]);
+		else SDL_RenderCopy(window->ren, sprites->getTexture(frameOf(type)), NULL, &rects[i]);
+	}
+	if (sprites->useAtlas) scratchBatch.submit(window->ren);
+}
+
+bool Tilemap::solidInArea(int x1, int y1, int x2, int y2) const
+{
+	if (x1 < 0) x1 = 0;
+	if (y1 < 0) y1 = 0;
+	if (x2 >= horiTiles) x2 = horiTiles - 1;
+	if (y2 >= vertiTiles) y2 = vertiTiles - 1;
+	if (x1 > x2 || y1 > y2) return false;
+
+	//test up to 64 tiles of a row at once, masking off the bits outside x1..x2 in the first and last word
+	int firstWord = x1 / 64;
+	int lastWord = x2 / 64;
+	Uint64 firstBits = ~Uint64(0) << (x1 % 64);
+	Uint64 lastBits = ~Uint64(0) >> (63 - x2 % 64);
+
+	for (int y = y1; y <= y2; y++)
+	{
+		const Uint64 *row = &solidMask[y*maskWords];
+		if (firstWord == lastWord)
+		{
+			if (row[firstWord] & firstBits & lastBits) return true;
+			continue;
+		}
+
+		Uint64 hits = (row[firstWord] & firstBits) | (row[lastWord] & lastBits);
+		for (int i = firstWord + 1; i < lastWord; i++) hits |= row[i];
+		if (hits) return true;
+	}
+	return false;
+}
+
+//per type helpers for the sweep, the double ones are what the sweep always did
+static inline double sweepInfinity(double) { return numeric_limits<double>::infinity(); }
+static inline Fixed sweepInfinity(Fixed) { return Fixed::max(); }
+static inline int tileFloor(double v, int tileRes) { return int(floor(v / tileRes)); }
+static inline int tileCeil(double v, int tileRes) { return int(ceil(v / tileRes)); }
+static inline double snapToTile(double v, int tileRes) { return floor(v / tileRes + 0.5)*tileRes; }
+
+static inline int tileFloor(Fixed v, int tileRes)
+{
+	Sint64 size = tileRes * Fixed::ONE;
+	Sint64 tile = v.raw / size;
+	if (v.raw % size && v.raw < 0) tile--;
+	return int(tile);
+}
+
+static inline int tileCeil(Fixed v, int tileRes) { return -tileFloor(-v, tileRes); }
+static inline Fixed snapToTile(Fixed v, int tileRes) { return tileFloor(v + Fixed(tileRes) / 2, tileRes)*tileRes; }
+
+//when a box edge moving at speed d reaches a surface, and when it's past it
+//the box spans [lo, hi) and the obstacle [first, last), without motion it either always or never overlaps
+template <class T>
+static inline void sweepAxis(T lo, T hi, T d, T first, T last, T &enter, T &exit)
+{
+	const T infinity = sweepInfinity(T());
+	if (d > T(0))
+	{
+		enter = (first - hi) / d;
+		exit = (last - lo) / d;
+	}
+	else if (d < T(0))
+	{
+		enter = (last - lo) / d;
+		exit = (first - hi) / d;
+	}
+	else if (hi > first && lo < last)
+	{
+		enter = -infinity;
+		exit = infinity;
+	}
+	else enter = exit = infinity;
+}
+
+//shared by the double and the fixed point sweep, T is the number type and Hit the matching result
+template <class T, class Hit>
+static Hit sweepBox(const Tilemap &map, T x, T y, T w, T h, T dx, T dy)
+{
+	const int tileRes = map.tileRes;
+	Hit hit = { T(1), x + dx, y + dy, 0, 0 };
+	T earliest = T(1);	//contacts right at the end of the motion count too, so the normal is still reported
+
+	//a contact at time t on an axis, ties prefer the vertical one so landing wins over the side of the next tile
+	auto consider = [&](T t, int normalX, int normalY)
+	{
+		if (t > earliest) return;
+		if ((hit.normalX || hit.normalY) && t == earliest && !normalY) return;
+		earliest = t;
+		hit.normalX = normalX;
+		hit.normalY = normalY;
+	};
+
+	//the map edge is as solid as the tiles, like in solidDistance
+	T mapW = T(map.horiTiles*tileRes);
+	T mapH = T(map.vertiTiles*tileRes);
+	if (dx > T(0) && x + w <= mapW) consider((mapW - x - w) / dx, -1, 0);
+	if (dx < T(0) && x >= T(0)) consider(-x / dx, 1, 0);
+	if (dy > T(0) && y + h <= mapH) consider((mapH - y - h) / dy, 0, -1);
+	if (dy < T(0) && y >= T(0)) consider(-y / dy, 0, 1);
+
+	//every solid tile the motion could reach, found through the solid mask a word at a time
+	int x1 = max(tileFloor(min(x, x + dx), tileRes), 0);
+	int y1 = max(tileFloor(min(y, y + dy), tileRes), 0);
+	int x2 = min(tileCeil(max(x + w, x + w + dx), tileRes) - 1, map.horiTiles - 1);
+	int y2 = min(tileCeil(max(y + h, y + h + dy), tileRes) - 1, map.vertiTiles - 1);
+
+	for (int ty = y1; ty <= y2; ty++)
+	{
+		T enterY, exitY;
+		sweepAxis<T>(y, y + h, dy, T(ty*tileRes), T((ty + 1)*tileRes), enterY, exitY);
+		if (enterY > earliest || exitY <= T(0)) continue;
+
+		for (int word = x1 / 64; word <= x2 / 64; word++)
+		{
+			Uint64 bits = map.solidMask[ty*map.maskWords + word];
+			int tx = word * 64;
+			if (tx < x1)
+			{
+				bits >>= x1 - tx;
+				tx = x1;
+			}
+
+			for (; bits && tx <= x2; bits >>= 1, tx++)
+			{
+				if (!(bits & 1)) continue;
+
+				T enterX, exitX;
+				sweepAxis<T>(x, x + w, dx, T(tx*tileRes), T((tx + 1)*tileRes), enterX, exitX);
+
+				T enter = max(enterX, enterY);
+				T exit = min(exitX, exitY);
+				if (enter < T(0) || enter >= exit || enter > T(1)) continue;	//missed, moving away or already inside
+
+				if (enterY >= enterX) consider(enter, 0, dy > T(0) ? -1 : 1);
+				else consider(enter, dx > T(0) ? -1 : 1, 0);
+			}
+		}
+	}
+
+	if (!hit.normalX && !hit.normalY) return hit;
+
+	//stop at the contact and put the box exactly against the surface, so rounding can't sink it in
+	hit.time = earliest;
+	hit.x = x + dx*earliest;
+	hit.y = y + dy*earliest;
+	if (hit.normalX) hit.x = hit.normalX < 0 ? snapToTile(hit.x + w, tileRes) - w : snapToTile(hit.x, tileRes);
+	if (hit.normalY) hit.y = hit.normalY < 0 ? snapToTile(hit.y + h, tileRes) - h : snapToTile(hit.y, tileRes);
+	return hit;
+}
+
+SweepHit Tilemap::sweep(double x, double y, double w, double h, double dx, double dy) const
+{
+	return sweepBox<double, SweepHit>(*this, x, y, w, h, dx, dy);
+}
+
+FixedSweepHit Tilemap::sweep(Fixed x, Fixed y, Fixed w, Fixed h, Fixed dx, Fixed dy) const
+{
+	return sweepBox<Fixed, FixedSweepHit>(*this, x, y, w, h, dx, dy);
+}
+
+//free tiles in a row or column including this one, based on the entry of the next tile over
+static inline Uint16 extendRun(bool solid, Uint16 next)
+{
+	if (solid) return 0;
+	return next == UINT16_MAX ? next : next + 1;
+}
+
+void Tilemap::buildSolidIndex()
+{
+	solidVersion++;
+
+	maskWords = (horiTiles + 63) / 64;
+	solidMask.assign(maskWords*vertiTiles, 0);
+	for (int y = 0; y < vertiTiles; y++)
+	{
+		for (int x = 0; x < horiTiles; x++)
+		{
+			if (isSolid(tiles[y*horiTiles + x])) solidMask[y*maskWords + x / 64] |= Uint64(1) << (x % 64);
+		}
+	}
+
+	distUp.resize(tiles.size());
+	distDown.resize(tiles.size());
+	distLeft.resize(tiles.size());
+	distRight.resize(tiles.size());
+
+	for (int y = 0; y < vertiTiles; y++)
+	{
+		int row = y*horiTiles;
+		for (int x = 0; x < horiTiles; x++)
+		{
+			int in = row + x;
+			distLeft[in] = extendRun(isSolid(tiles[in]), x > 0 ? distLeft[in - 1] : 0);
+			distUp[in] = extendRun(isSolid(tiles[in]), y > 0 ? distUp[in - horiTiles] : 0);
+		}
+	}
+	for (int y = vertiTiles - 1; y >= 0; y--)
+	{
+		int row = y*horiTiles;
+		for (int x = horiTiles - 1; x >= 0; x--)
+		{
+			int in = row + x;
+			distRight[in] = extendRun(isSolid(tiles[in]), x < horiTiles - 1 ? distRight[in + 1] : 0);
+			distDown[in] = extendRun(isSolid(tiles[in]), y < vertiTiles - 1 ? distDown[in + horiTiles] : 0);
+		}
+	}
+
+	indexAnimatedCells();
+}
+
+void Tilemap::updateDistances(int x, int y)
+{
+	//only the free run the tile belongs to changes, so walk away from the tile until the next solid one
+	//right/down distances change behind the tile, left/up distances change ahead of it
+	int row = y*horiTiles;
+	for (int i = x; i >= 0; i--)
+	{
+		int in = row + i;
+		distRight[in] = extendRun(isSolid(tiles[in]), i < horiTiles - 1 ? distRight[in + 1] : 0);
+		if (i != x && isSolid(tiles[in])) break;
+	}
+	for (int i = x; i < horiTiles; i++)
+	{
+		int in = row + i;
+		distLeft[in] = extendRun(isSolid(tiles[in]), i > 0 ? distLeft[in - 1] : 0);
+		if (i != x && isSolid(tiles[in])) break;
+	}
+	for (int i = y; i >= 0; i--)
+	{
+		int in = i*horiTiles + x;
+		distDown[in] = extendRun(isSolid(tiles[in]), i < vertiTiles - 1 ? distDown[in + horiTiles] : 0);
+		if (i != y && isSolid(tiles[in])) break;
+	}
+	for (int i = y; i < vertiTiles; i++)
+	{
+		int in = i*horiTiles + x;
+		distUp[in] = extendRun(isSolid(tiles[in]), i > 0 ? distUp[in - horiTiles] : 0);
+		if (i != y && isSolid(tiles[in])) break;
+	}
+}
+
+void Tilemap::evictChunk(unordered_map<int, TileChunk> &cache)
+{
+	//throw out the least recently visible chunk, never one that is visible right now
+	auto oldest = cache.end();
+	for (auto it = cache.begin(); it != cache.end(); ++it)
+	{
+		if (it->second.lastUsed == updateCounter) continue;
+		if (oldest == cache.end() || it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+	}
+
+	if (oldest == cache.end()) return;	//everything is visible, go over budget rather than thrash
+	SDL_DestroyTexture(oldest->second.tex);
+	cache.erase(oldest);
 }
\ No newline at end of file
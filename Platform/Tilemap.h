@@ -1,11 +1,73 @@
 #pragma once
 
 #include <iostream>
+#include <unordered_map>
 #include <SDL2/SDL.h>
 #include "Spritesheet.h"
+#include "Direction.h"
+#include "SpriteBatch.h"
+#include "Fixed.h"
 
 using namespace std;
 
+struct MapReader;
+class AssetCache;
+class TileStore;
+
+//pre-rendered square block of the map
+struct TileChunk
+{
+	SDL_Texture* tex;
+	int chunkX;			//position in chunks
+	int chunkY;
+	unsigned lastUsed;	//update the chunk was last visible in, for eviction
+};
+
+const char EMPTY_TILE = -1;	//nothing is drawn for it, so layers below show through
+
+//where a box moving through the map first touches a solid tile or the map edge
+struct SweepHit
+{
+	double time;		//fraction of the motion before contact, 1 without a hit
+	double x;			//top left of the box at that point, exactly against the surface on the contact axis
+	double y;
+	int normalX;		//points away from the surface that was hit, both 0 without a hit
+	int normalY;
+};
+
+//the same in fixed point, for simulations that have to come out bit for bit the same everywhere
+struct FixedSweepHit
+{
+	Fixed time;
+	Fixed x;
+	Fixed y;
+	int normalX;
+	int normalY;
+};
+
+//tile type that cycles through sprite frames like Entity::animateLoop, tiles keep the type itself
+//so collision and editing don't see the animation
+struct TileAnimation
+{
+	vector<char> frames;	//sprite frames in order
+	unsigned frameDelay;	//updates every frame is shown for after the first one
+	unsigned counter;
+	unsigned currentFrame;
+	//every tile of the type in tiles by the render chunk it's in, so a new frame only redraws the cached ones
+	unordered_map<int, vector<int>> cells;
+};
+
+//extra plane of tiles drawn behind or in front of the main one, takes no part in collision
+struct TileLayer
+{
+	vector<char> tiles;		//same size as the map
+	float scrollX;			//parallax, 1 scrolls with the map, smaller values lag behind like distant scenery
+	float scrollY;
+	bool isStatic;			//drawn once into cached chunks, otherwise redrawn every frame so it can change freely
+	bool foreground;		//drawn by renderForeground, after entities
+	unordered_map<int, TileChunk> chunks;	//static layers only
+};
+
 //this contains the types (indices) of tiles in the game level
 //is analogous to the .map format
 class Tilemap
@@ -19,15 +81,114 @@ public:
 	int vertiTiles;			//size of map in tiles
 	int horiTiles;
 	string bitMapName;		//which image the tile textures are fetched from
-	vector<char> tiles;		//type of tile
-	SDL_Texture* fullTex;	//texture to be rendered
+	vector<char> tiles;		//type of tile, this is the layer used for collision
+	vector<TileLayer> layers;	//drawn in order, background ones before tiles and foreground ones after
 	Spritesheet *sprites;
+	AssetCache *assets;		//if set, sprites is looked up from bitMapName whenever a map is loaded or created
+
+	//render cache, the map is drawn in chunks that are kept around until evicted
+	int chunkSize;			//size of chunks in tiles
+	unsigned maxChunks;		//texture budget per layer, chunks that are not visible get evicted past this
+	unordered_map<int, TileChunk> chunks;
+	unsigned updateCounter;
+
+	//with an atlas sheet the visible tiles can instead be drawn straight from the atlas as one batch,
+	//which is rebuilt only when the view or the tiles change
+	bool batched;
+	SpriteBatch viewBatch;
+	bool batchDirty;
+	SDL_Rect batchView;		//view in pixels the batch was built for
+
+	//with wrapped set the tiles are instead kept in a render target one tile larger than the view that wraps around
+	//at its edges, scrolling only draws the tiles that came into view and presenting takes at most four copies
+	bool wrapped;
+	SDL_Texture *ring;
+	int ringW;				//size in tiles
+	int ringH;
+	int ringX;				//first tile the ring holds
+	int ringY;
+	bool ringValid;
+	bool ringTransparent;
+
+	//edited and animated tiles waiting to be redrawn into their chunks
+	vector<int> dirtyTiles;
+	vector<bool> dirtyMask;	//one per tile so a cell is only queued once
 
-	void loadFile(const string &_file);
-	void saveFile(const string &_file);
+	//animated types, stepped by update
+	unordered_map<char, TileAnimation> animations;
+	char tileFrames[256];	//sprite frame every type is drawn with, indexed by the type as Uint8
+	vector<char> steppedTypes;	//changed frame since the cached chunks of static layers were last brought up to date
+
+	//for every tile, how many free tiles there are in each direction before a solid one or the map edge
+	//saturates at UINT16_MAX, solidDistance continues from there
+	vector<Uint16> distUp;
+	vector<Uint16> distDown;
+	vector<Uint16> distLeft;
+	vector<Uint16> distRight;
+
+	//one bit per tile, set for solid ones, every row starts on a new word
+	vector<Uint64> solidMask;
+	int maskWords;			//words per row
+	unsigned solidVersion;	//changes whenever a tile becomes solid or free, for caches built on the layout
+
+	bool loadFile(const string &_file);		//reads both the current and the legacy .map layout
+	bool saveFile(const string &_file, bool compress = true);
 	void create(char _tileRes, unsigned _vertiTiles, unsigned _horiTiles, const string& _bitMapName);
-	void render(Window *window);
-	void update(Window *window);
-	void changeTile(unsigned x, unsigned y, char type, Window *window);
+	void loadRegion(TileStore &store, int x, int y, int w, int h);	//dense copy of part of an open world, without layers
+	void acquireSprites();	//swap sprites for the sheet bitMapName names, needs assets
+	void render(Window *window);			//background layers and tiles
+	void renderForeground(Window *window);	//foreground layers, after everything else
+	void update(Window *window);	//redraw edited tiles and make sure every visible chunk is cached
+	void changeTile(unsigned x, unsigned y, char type);	//takes effect on the next update
+	TileLayer& addLayer(float scrollX, float scrollY, bool isStatic, bool foreground);	//filled with EMPTY_TILE
+	void changeLayerTile(unsigned layer, unsigned x, unsigned y, char type);
+	//frames are sprite frames, the first one shows right away, no frames makes the type static again
+	void animateTile(char type, const vector<char> &frames, unsigned frameDelay);
+	inline char frameOf(char type) const { return tileFrames[(Uint8)type]; }
 	char getTile(unsigned x, unsigned y) const;
-};
\ No newline at end of file
+	inline bool isSolid(char type) const { return type == 1; }
+	int solidDistance(int x, int y, Direction direction) const;	//free tiles from x,y onwards, 0 if x,y is solid or outside the map
+	bool solidInArea(int x1, int y1, int x2, int y2) const;	//inclusive tile coordinates, parts outside the map are ignored
+	//continuous collision for a w*h box at x,y in pixels moving by dx,dy, exact for any length of motion
+	//boxes only touching a tile don't collide with it, tiles the box already overlaps are ignored
+	SweepHit sweep(double x, double y, double w, double h, double dx, double dy) const;
+	FixedSweepHit sweep(Fixed x, Fixed y, Fixed w, Fixed h, Fixed dx, Fixed dy) const;
+	void clearChunks();
+	//distance tables, solid mask and cells of animated types, call after writing to tiles directly, changeTile keeps them up to date by itself
+	void buildSolidIndex();
+
+private:
+	bool readSections(MapReader &reader);
+	bool readInfo(MapReader &reader);
+	bool readTiles(MapReader &reader, Uint8 encoding, vector<char> &out);
+	bool readLayer(MapReader &reader);
+	bool readAnimations(MapReader &reader);
+	void visibleChunks(const SDL_Rect &view, int &firstX, int &firstY, int &lastX, int &lastY) const;
+	void cacheChunks(unordered_map<int, TileChunk> &cache, const vector<char> &source, bool transparent, const SDL_Rect &view, Window *window);
+	void renderChunks(const unordered_map<int, TileChunk> &cache, const SDL_Rect &view, Window *window) const;
+	TileChunk& loadChunk(unordered_map<int, TileChunk> &cache, const vector<char> &source, bool transparent, int cx, int cy, Window *window);
+	void drawChunk(TileChunk &chunk, const vector<char> &source, bool transparent, Window *window);
+	void drawTiles(const vector<char> &source, const SDL_Rect &area, int offsetX, int offsetY, Window *window);
+	void renderLayer(TileLayer &layer, Window *window);
+	void updateRing(Window *window);
+	void drawRingTiles(int x1, int y1, int x2, int y2, Window *window);	//inclusive, clipped to what the ring holds
+	void renderRing(Window *window);
+	void flushDirty(Window *window);
+	void drawCells(const vector<char> &source, const int *cells, const SDL_Rect *rects, unsigned count, bool transparent, Window *window);	//clears rects[i] and draws cells[i] into it
+	void markDirty(int in);
+	inline int chunkOf(int in) const { return (in / horiTiles / chunkSize)*((horiTiles + chunkSize - 1) / chunkSize) + in % horiTiles / chunkSize; }
+	void animateTiles();	//steps every animation, cells of the ones that changed frame become dirty
+	void markAnimated(char type, const TileAnimation &animation);	//the cells that are drawn somewhere
+	void redrawStepped(Window *window);	//cells of steppedTypes in the cached chunks of static layers
+	void indexAnimatedCells();
+	void buildBatch(const vector<char> &source, const SDL_Rect &view, SpriteBatch &batch, int offsetX, int offsetY) const;
+	void tilesIn(const SDL_Rect &area, int &firstX, int &firstY, int &lastX, int &lastY) const;	//clipped to the map
+	SDL_Rect viewOf(Window *window, float scrollX = 1.0f, float scrollY = 1.0f) const;
+	bool hasBackground() const;		//tiles have to be drawn with transparency when something is behind them
+	void updateDistances(int x, int y);
+	void evictChunk(unordered_map<int, TileChunk> &cache);
+
+	SpriteBatch scratchBatch;	//reused for chunk, ring and dynamic layer draws
+	vector<SDL_Rect> scratchRects;
+	vector<int> scratchCells;
+};
@@ -2,8 +2,8 @@
 
 Window::Window()
 {
-	SDL_Window* win = nullptr;
-	SDL_Renderer* ren = nullptr;
+	win = nullptr;
+	ren = nullptr;
 	area.x = 0;
 	area.y = 0;
 	area.w = 0;
@@ -25,7 +25,7 @@ Window::~Window()
 		SDL_DestroyWindow(win);
 	}
 }
-bool Window::init(const string &_title, int _width, int _height)
+bool Window::init(const string &_title, int _width, int _height, Uint32 rendererFlags)
 {
 	title = _title;
 	area.w = _width;
@@ -40,7 +40,7 @@ bool Window::init(const string &_title, int _width, int _height)
 	}
 
 	//Create renderer for window
-	ren = SDL_CreateRenderer(win, -1, SDL_RENDERER_ACCELERATED);
+	ren = SDL_CreateRenderer(win, -1, rendererFlags);
 	if (ren == NULL)
 	{
 		printf("Renderer could not be created! SDL Error: %s\n", SDL_GetError());
@@ -12,7 +12,7 @@ class Window
 public:
 	Window();
 	~Window();
-	bool init(const string &_title, int _width, int _height);
+	bool init(const string &_title, int _width, int _height, Uint32 rendererFlags = SDL_RENDERER_ACCELERATED);
 
 	void handleEvents(SDL_Event *e);
 
@@ -23,7 +23,7 @@ public:
 	SDL_Renderer* ren;
 	SDL_Rect area;
 
-	int offsetX;
+	int offsetX;		//camera position in pixels
 	int offsetY;
 
 	bool mouseFocus;
@@ -1,5 +1,11 @@
 #include "Window.h"
 #include "Tilemap.h"
+#include "Character.h"
+#include "SheetLoader.h"
+#include "AssetCache.h"
+#include "Profiler.h"
+#include "InputLog.h"
+#include "JobSystem.h"
 #include <iostream>
 #include <chrono>
 #include <vector>
@@ -14,459 +20,327 @@ using namespace std::chrono;
 
 const int SCREEN_WIDTH = 32*32;
 const int SCREEN_HEIGHT = 32*18;
+const double TICK_TIME = 1.0 / 120.0;	//length of one simulation step in seconds
+const int MAX_TICKS_PER_FRAME = 8;		//after a stall, drop the time that is left over instead of trying to catch up
 Window mainWindow;
+AssetCache assets(&mainWindow);
 Tilemap gameMap;
 
-enum Direction
-{
-	NONE,
-	LEFT,
-	RIGHT,
-	UP,
-	DOWN
-};
-
-struct intVector
-{
-	int x;
-	int y;
-};
-
-struct doubleVector
-{
-	double x;
-	double y;
-};
-
-int min(int a, int b)
-{
-	return a < b ? a : b;
-}
-
-double min(double a, double b)
-{
-	return a < b ? a : b;
-}
-
-double max(double a, double b)
-{
-	return a > b ? a : b;
-}
-
-
-class Character
-{
-public:
-	Character();
-	void move(double deltaTime);
-	void jump();
-	double scanDistance(double edge, const Tilemap& map, Direction direction, intVector firstTile, intVector lastTile);
-	double scanBoundary(Direction direction, const Tilemap& map);
-
-	doubleVector velocity;
-	double gravity;
-	double runSpeed;
-	double airSpeed;
-	double jumpVelocity;
-	double jumpHeight;
-	double jumpHeightMax;
-	double terminalVelocity;
-	doubleVector position;
-	doubleVector origin;
-
-	SDL_Rect rect;
-
-	bool airBorne;
-	bool freeFall;
-};
-
-Character::Character()
-{
-	velocity.x = 0.0;
-	velocity.y = 0.0;
-	gravity = 0.0;
-	runSpeed = 0.0;
-	jumpVelocity = 0.0;
-	jumpHeight = 0.0;
-	jumpHeightMax = 0.0;
-	terminalVelocity = 0.0;
-	position.x = 0.0;
-	position.y = 0.0;
-	origin.x = 0.0;
-	origin.y = 0.0;
-	//bounds.left = 0.0;
-	//bounds.right = 0.0;
-	//bounds.up = 0.0;
-	//bounds.down = 0.0;
-	rect.x = 0;
-	rect.y = 0;
-	rect.w = 0;
-	rect.h = 0;
-	airBorne = false;
-	freeFall = false;
-}
-
-void Character::move(double deltaTime)
+bool init()
 {
-	////////////////Y_AXIS///////////////////////////
-	double downBound = scanBoundary(DOWN, gameMap);
-
-	
-	if (!airBorne)	//grounded
+	//Initialize SDL
+	if (SDL_Init(SDL_INIT_VIDEO) < 0)
 	{
-		if (downBound > 0.0001)	//fall through
-		{
-			airBorne = true;
-			freeFall = true;
-		}
+		printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
+		return false;
 	}
 
-	if (airBorne)	//airborne
+	//Set texture filtering to linear
+	if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1"))
 	{
-		double heightVector = velocity.y * deltaTime;
-		if (velocity.y < 0.0)	//rising
-		{	
-			double upBound = scanBoundary(UP, gameMap);
-			
-				
-			if (!freeFall)	//actively jumping
-			{
-
-				if (jumpHeight >= jumpHeightMax)	//max jump
-				{
-					//heightVector = (jumpHeight - jumpHeightMax);
-					jumpHeight = 0.0;
-					freeFall = true;
-				}
-				else jumpHeight -= heightVector;
-			}	
-
-			if (-heightVector > upBound) //hit ceiling
-			{
-				position.y -= upBound;
-				jumpHeight = 0.0;
-				freeFall = true;
-				velocity.y = 0.0;
-			}
-			else position.y += heightVector;
-		}
-		else //falling
-		{
-			position.y += min(heightVector, downBound);
-
-			//landing
-			if (downBound < 0.0001)
-			{
-				jumpHeight = 0.0;
-				airBorne = false;
-				freeFall = false;
-				velocity.y = 0.0;
-			}
-		}
-
-		if (freeFall && velocity.y < terminalVelocity)	//gravity
-		{
-			velocity.y = min(velocity.y + gravity * deltaTime, terminalVelocity);
-		}
+		printf("Warning: Linear texture filtering not enabled!");
 	}
 
-	rect.y = int(position.y - origin.y); //truncation is fine
+	if (!mainWindow.init("Platform", SCREEN_WIDTH, SCREEN_HEIGHT)) return false;
 
-	///////////////////////X-Axis//////////////////////////
-	if (velocity.x < 0.0)
-	{
-		position.x += max(velocity.x * deltaTime, -scanBoundary(LEFT, gameMap));
-	}
-	else if (velocity.x > 0.0)
+	//Initialize PNG loading
+	int imgFlags = IMG_INIT_PNG;
+	if (!(IMG_Init(imgFlags) & imgFlags))
 	{
-		position.x += min(velocity.x * deltaTime, scanBoundary(RIGHT, gameMap));
+		printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
+		return false;
 	}
 
-	rect.x = int(position.x - origin.x);
+	return true;
 }
 
-void Character::jump()
+//progress bar while sheets are loading in the background
+void drawLoading(float progress)
 {
-	airBorne = true;
-	velocity.y = -jumpVelocity;
+	SDL_SetRenderDrawColor(mainWindow.ren, 0, 0, 0, 255);
+	SDL_RenderClear(mainWindow.ren);
+
+	SDL_Rect bar;
+	bar.w = int(SCREEN_WIDTH / 2 * progress);
+	bar.h = 16;
+	bar.x = SCREEN_WIDTH / 4;
+	bar.y = (SCREEN_HEIGHT - bar.h) / 2;
+	SDL_SetRenderDrawColor(mainWindow.ren, 255, 255, 255, 255);
+	SDL_RenderFillRect(mainWindow.ren, &bar);
+	SDL_RenderPresent(mainWindow.ren);
 }
 
-double Character::scanDistance(double edge, const Tilemap& map, Direction direction, intVector firstTile, intVector lastTile)
+void close()
 {
-	double distance;
+	IMG_Quit();
+	SDL_Quit();
+}
 
-	//indices of tile to be checked
-	int xi;
-	int yi;
+void spawnPlayer(Character &player)
+{
+	player.position.x = 100;
+	player.position.y = SCREEN_HEIGHT - 90;
+	player.gravity = 5000.0;
+	player.runSpeed = 500.0;
+	player.jumpVelocity = 800.0;
+	player.jumpHeightMax = 128.0;
+	player.terminalVelocity = 1024.0;
+
+	player.rect.w = 32;
+	player.rect.h = 64;
+	player.rect.x = int(player.position.x);
+	player.rect.y = int(player.position.y);
+	player.origin.x = (double)(player.rect.w / 2);
+	player.origin.y = (double)player.rect.h;
+	player.lastPosition = player.position;
+}
 
-	//to keep track of smallest value
-	int minDist = 1000000;
-	int distIndex;
+//one simulation step, everything it depends on comes in through buttons so a recorded run plays back the same
+//the game only simulates the player, which isn't worth splitting, so ticks run on the main thread
+//the job system is used for loading here, the batched simulation passes run on it in the benchmark
+void tick(Character &player, Uint8 buttons)
+{
+	if (buttons & INPUT_LEFT) player.velocity.x = -player.runSpeed;
+	else if (buttons & INPUT_RIGHT) player.velocity.x = player.runSpeed;
+	else player.velocity.x = 0.0;
 
-	//for each occupied tile, shoot a ray in desired direction
-	//insert smallest value in distance
-	for (int i = firstTile.y; i <= lastTile.y; i++)
+	if (!player.freeFall && (buttons & INPUT_JUMP))
 	{
-		for (int j = firstTile.x; j <= lastTile.x; j++)
-		{
-			yi = i;
-			xi = j;
-			distIndex = 0;
-
-			while (
-				distIndex < minDist
-				&& xi >= 0
-				&& yi >= 0
-				&& xi < map.horiTiles
-				&& yi < map.vertiTiles
-				&& map.getTile(xi, yi) != 1
-				)
-			{
-
-				switch (direction)
-				{
-				case LEFT:	xi--;	break;
-				case RIGHT:	xi++;	break;
-				case UP:	yi--;	break;
-				case DOWN:	yi++;	break;
-				}
-				distIndex++;
-			}
-			minDist = min(minDist, distIndex);
-		}
+		player.jump();
 	}
-
-	switch (direction)
+	else if (player.airBorne)
 	{
-	case LEFT:	distance = edge - (xi + 1)*map.tileRes;	break;
-	case RIGHT:	distance = xi*map.tileRes - edge;		break;
-	case UP:	distance = edge - (yi + 1)*map.tileRes;	break;
-	case DOWN:	distance = yi*map.tileRes - edge;		break;
+		player.freeFall = true;
 	}
 
-	return signbit(distance) ? 0.0 : distance;
+	player.move(TICK_TIME, gameMap);
 }
 
-double Character::scanBoundary(Direction direction, const Tilemap& map)
+//FNV-1a over everything the simulation carries from one tick to the next
+Uint64 simulationState(const Character &player)
 {
-	//scanner's shape is simplified: find every tile which scanner's hitbox overlaps with
-	//get the first and last indices of these tiles in both axes
-	int x1 = rect.x / map.tileRes;
-	int x2 = (rect.x + rect.w - 1) / map.tileRes;
-	int y1 = rect.y / map.tileRes;
-	int y2 = (rect.y + rect.h - 1) / map.tileRes;
-
-	intVector tile1;
-	intVector tile2;
-
-	double edge; //position of the relevant edge of the hitbox
-	switch (direction)
-	{
-	case LEFT:
+	double values[] = { double(player.position.x), double(player.position.y), double(player.velocity.x), double(player.velocity.y), double(player.jumpHeight) };
+	Uint64 hash = 14695981039346656037ULL;
+	auto mix = [&](const void *data, size_t size)
 	{
-		edge = position.x - origin.x;
-		tile1 = { x1,y1 };
-		tile2 = { x1,y2 };
-		break;
-	}
-	case RIGHT:
-	{
-		edge = position.x - origin.x + rect.w;
-		tile1 = { x2,y1 };
-		tile2 = { x2,y2 };
-		break;
-	}
-	case UP:
-	{
-		edge = position.y - origin.y;
-		tile1 = { x1,y1 };
-		tile2 = { x2,y1 };
-		break;
-	}
-	case DOWN:
-	{
-		edge = position.y - origin.y + rect.h;
-		tile1 = { x1,y2 };
-		tile2 = { x2,y2 };
-		break;
-	}
-	default: return 0.0;
-	}
-
-	//get maximum distance scanner can travel direction
-	return scanDistance(edge, map, direction, tile1, tile2);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= ((const Uint8 *)data)[i];
+			hash *= 1099511628211ULL;
+		}
+	};
+	mix(values, sizeof(values));
+	mix(&player.airBorne, sizeof(player.airBorne));
+	mix(&player.freeFall, sizeof(player.freeFall));
+	return hash;
 }
 
-
-bool init()
+//plays a recording back as fast as possible without a window, returns 0 if it ends up where the recording did
+int replay(const string &file)
 {
-	//Initialize SDL
-	if (SDL_Init(SDL_INIT_VIDEO) < 0)
-	{
-		printf("SDL could not initialize! SDL Error: %s\n", SDL_GetError());
-		return false;
-	}
-
-	//Set texture filtering to linear
-	if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1"))
-	{
-		printf("Warning: Linear texture filtering not enabled!");
-	}
+	InputLog log;
+	if (!log.load(file) || !gameMap.loadFile("testmap.map")) return 1;
 
-	if (!mainWindow.init("Platform", SCREEN_WIDTH, SCREEN_HEIGHT)) return false;
+	Character player;
+	spawnPlayer(player);
 
-	//Initialize PNG loading
-	int imgFlags = IMG_INIT_PNG;
-	if (!(IMG_Init(imgFlags) & imgFlags))
+	steady_clock::time_point start = steady_clock::now();
+	while (!log.finished())
 	{
-		printf("SDL_image could not initialize! SDL_image Error: %s\n", IMG_GetError());
-		return false;
+		tick(player, log.next());
 	}
+	double seconds = duration<double>(steady_clock::now() - start).count();
 
-	return true;
+	bool same = simulationState(player) == log.finalState;
+	cout << log.ticks << " ticks in " << seconds << " s, " << (same ? "final state matches" : "final state differs") << endl;
+	return same ? 0 : 1;
 }
 
-void close()
+int main(int argc, char *argv[])
 {
-	IMG_Quit();
-	SDL_Quit();
-}
+	//-uncapped renders as fast as possible, for benchmarking
+	//-profile records timing zones, F1 shows them over the game and F2 saves profile.json and profile.csv
+	//-record file saves the input of the session, -replay file plays one back headless and checks the result
+	bool uncapped = false;
+	bool showProfile = false;
+	string recordFile;
+	for (int i = 1; i < argc; i++)
+	{
+		if (string(argv[i]) == "-uncapped") uncapped = true;
+		if (string(argv[i]) == "-profile") Profiler::get().setEnabled(true);
+		if (string(argv[i]) == "-record" && i + 1 < argc) recordFile = argv[++i];
+		else if (string(argv[i]) == "-replay" && i + 1 < argc) return replay(argv[++i]);
+	}
 
-bool checkMapCollision(Character& scanner, const Tilemap& map)
-{
-	int x1 = scanner.rect.x / map.tileRes;
-	int x2 = (scanner.rect.x + scanner.rect.w - 1) / map.tileRes;
-	int y1 = scanner.rect.y / map.tileRes;
-	int y2 = (scanner.rect.y + scanner.rect.h - 1) / map.tileRes;
+	init();
 
-	for (int x = x1; x <= x2; x++)
 	{
-		for (int y = y1; y <= y2; y++)
+		JobSystem loaderJobs;
+		SheetLoader loader(&loaderJobs, &mainWindow);
+		assets.loader = &loader;
+
+		//the map names its sheet, which then decodes in the background
+		gameMap.assets = &assets;
+		gameMap.wrapped = true;
+		gameMap.loadFile("testmap.map");
+
+		while (!loader.done())
 		{
-			if (x < 0 || x >= map.horiTiles || y < 0 || y >= map.vertiTiles) continue;
-			if (map.getTile(x, y) == 1) return true;
+			SDL_PumpEvents();
+			loader.poll();
+			drawLoading(loader.progress());
 		}
+		assets.loader = nullptr;
 	}
-	return false;
-}
-
-int main()
-{
-	init();
-
-	Spritesheet levelSprites("testpic.png", 32, &mainWindow);
-	gameMap.sprites = &levelSprites;
-	gameMap.loadFile("testmap.map");
-	gameMap.update(&mainWindow);
 
 	Character Player;
-	Player.position.x = 100;
-	Player.position.y = SCREEN_HEIGHT - 90;
-	Player.gravity = 5000.0;
-	Player.runSpeed = 500.0;
-	Player.jumpVelocity = 800.0;
-	Player.jumpHeightMax = 128.0;
-	Player.terminalVelocity = 1024.0;
-
-	Player.rect.w = 32;
-	Player.rect.h = 64;
-	Player.rect.x = int(Player.position.x);
-	Player.rect.y = int(Player.position.y);
-	Player.origin.x = (double)(Player.rect.w / 2);
-	Player.origin.y = (double)Player.rect.h;
+	spawnPlayer(Player);
+
+	InputLog log;
+	log.startRecording((Uint32)steady_clock::now().time_since_epoch().count());
+	int moveDirection = 0;	//the direction pressed last wins while both are held
 
 	const Uint8 *keystate = SDL_GetKeyboardState(NULL);
 	SDL_Event e;
 	bool quit = false;
 
-	double frameTime = 0.0;
-	system_clock::time_point lastTime = system_clock::now();
+	//simulation runs in fixed steps, rendering happens once per loop and interpolates between steps
+	double accumulator = 0.0;
+	steady_clock::time_point lastTime = steady_clock::now();
 	while (!quit)
 	{
-		frameTime = duration_cast<microseconds>(system_clock::now() - lastTime).count() / 1000000.0;
-		if (frameTime > 0.1) frameTime = 0.1;	//at low framerates game becomes frame dependent to avoid collision errors etc.
-		lastTime = system_clock::now();
+		steady_clock::time_point now = steady_clock::now();
+		accumulator += duration<double>(now - lastTime).count();
+		lastTime = now;
+		Profiler::get().beginFrame();
 
 
 		//event block
-		SDL_PumpEvents();
-		while (SDL_PollEvent(&e))
 		{
-			if (e.type == SDL_WINDOWEVENT)
-			{
-				mainWindow.handleEvents(&e);
-			}
-			if (e.type == SDL_QUIT)
-			{
-				quit = true;
-			}
-			if (e.type == SDL_KEYDOWN)
+			PROFILE_ZONE("events");
+			SDL_PumpEvents();
+			while (SDL_PollEvent(&e))
 			{
-				switch (e.key.keysym.sym)
-				{
-				case SDLK_a:
-				case SDLK_LEFT: 
+				if (e.type == SDL_WINDOWEVENT)
 				{
-					Player.velocity.x = -Player.runSpeed;
-					break;
+					mainWindow.handleEvents(&e);
 				}
-				case SDLK_d:
-				case SDLK_RIGHT:	
+				if (e.type == SDL_QUIT)
 				{
-					Player.velocity.x = Player.runSpeed;
-					break;
-				}
-				default: break;
+					quit = true;
 				}
-			}
-			else if (e.type == SDL_KEYUP)
-			{
-				switch (e.key.keysym.sym)
-				{
-				case SDLK_a:
-				case SDLK_LEFT:
+				if (e.type == SDL_KEYDOWN)
 				{
-					if (keystate[SDL_SCANCODE_RIGHT] || keystate[SDL_SCANCODE_D]) Player.velocity.x = Player.runSpeed;
-					else Player.velocity.x = 0.0;
-					break;
+					switch (e.key.keysym.sym)
+					{
+					case SDLK_a:
+					case SDLK_LEFT: 
+					{
+						moveDirection = -1;
+						break;
+					}
+					case SDLK_d:
+					case SDLK_RIGHT:	
+					{
+						moveDirection = 1;
+						break;
+					}
+					case SDLK_F1: showProfile = !showProfile; break;
+					case SDLK_F2:
+					{
+						Profiler::get().exportTrace("profile.json");
+						Profiler::get().exportCSV("profile.csv");
+						break;
+					}
+					default: break;
+					}
 				}
-				case SDLK_d:
-				case SDLK_RIGHT:
+				else if (e.type == SDL_KEYUP)
 				{
-					if (keystate[SDL_SCANCODE_LEFT] || keystate[SDL_SCANCODE_A]) Player.velocity.x = -Player.runSpeed;
-					else Player.velocity.x = 0.0;
-					break;
-				}
-				default: break;
+					switch (e.key.keysym.sym)
+					{
+					case SDLK_a:
+					case SDLK_LEFT:
+					{
+						if (keystate[SDL_SCANCODE_RIGHT] || keystate[SDL_SCANCODE_D]) moveDirection = 1;
+						else moveDirection = 0;
+						break;
+					}
+					case SDLK_d:
+					case SDLK_RIGHT:
+					{
+						if (keystate[SDL_SCANCODE_LEFT] || keystate[SDL_SCANCODE_A]) moveDirection = -1;
+						else moveDirection = 0;
+						break;
+					}
+					default: break;
+					}
 				}
 			}
 		}
 
-		if (!Player.freeFall && (keystate[SDL_SCANCODE_UP] || keystate[SDL_SCANCODE_W]))
-		{
-			Player.jump();
-		}
-		else if (Player.airBorne)
+		//simulation block
 		{
-			Player.freeFall = true;
-		}
+			PROFILE_ZONE("physics");
+			int ticks = 0;
+			while (accumulator >= TICK_TIME)
+			{
+				if (ticks == MAX_TICKS_PER_FRAME)
+				{
+					accumulator = fmod(accumulator, TICK_TIME);
+					break;
+				}
+
+				Uint8 buttons = 0;
+				if (moveDirection < 0) buttons |= INPUT_LEFT;
+				if (moveDirection > 0) buttons |= INPUT_RIGHT;
+				if (keystate[SDL_SCANCODE_UP] || keystate[SDL_SCANCODE_W]) buttons |= INPUT_JUMP;
+				log.record(buttons);
+				tick(Player, buttons);
 
-		Player.move(frameTime);
+				accumulator -= TICK_TIME;
+				ticks++;
+			}
+		}
 
-	
 		//rendering block
 		SDL_SetRenderDrawColor(mainWindow.ren, 0, 0, 0, 255);
 		SDL_RenderClear(mainWindow.ren);
 
-		gameMap.render(&mainWindow);
+		{
+			PROFILE_ZONE("map update");
+			gameMap.update(&mainWindow);	//cheap unless the view reached chunks that aren't cached
+		}
+		{
+			PROFILE_ZONE("map render");
+			gameMap.render(&mainWindow);
+		}
 
 		if (checkMapCollision(Player, gameMap)) SDL_SetRenderDrawColor(mainWindow.ren, 0, 0, 255, 255);
 		else SDL_SetRenderDrawColor(mainWindow.ren, 255, 0, 0, 255);
 
-		SDL_RenderFillRect(mainWindow.ren, &Player.rect);
-		SDL_RenderPresent(mainWindow.ren);
+		SDL_Rect playerRect = Player.interpolate(accumulator / TICK_TIME);
+		SDL_RenderFillRect(mainWindow.ren, &playerRect);
+		gameMap.renderForeground(&mainWindow);
+		if (showProfile)
+		{
+			SDL_Rect graph = { 8, 8, Profiler::historySize, 100 };
+			Profiler::get().renderOverlay(&mainWindow, graph);
+		}
 
-		SDL_Delay(1);
+		{
+			PROFILE_ZONE("present");
+			SDL_RenderPresent(mainWindow.ren);
+		}
+		Profiler::get().endFrame();
+
+		if (!uncapped) SDL_Delay(1);
+	}
+
+	if (!recordFile.empty())
+	{
+		log.finalState = simulationState(Player);
+		log.save(recordFile);
 	}
 
 	close();